@@ -0,0 +1,196 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+void flattenNode(aiNode const* node, std::int32_t parent, NodeHierarchy& hierarchy)
+{
+    std::uint32_t const index = static_cast<std::uint32_t>(hierarchy.nodes.size());
+    hierarchy.nodes.push_back(node);
+    hierarchy.parents.push_back(parent);
+    hierarchy.indexByName.emplace(std::string{ node->mName.C_Str() }, index);
+
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        flattenNode(node->mChildren[i], static_cast<std::int32_t>(index), hierarchy);
+    }
+}
+
+// Index of the last key whose time is <= time, clamped to the key range.
+template<typename Key>
+unsigned int findKey(Key const* keys, unsigned int keyCount, double time)
+{
+    Key const* upper = std::upper_bound(keys, keys + keyCount, time,
+        [](double t, Key const& key) { return t < key.mTime; });
+    if (upper == keys) {
+        return 0;
+    }
+    return static_cast<unsigned int>(upper - keys - 1);
+}
+
+template<typename Key>
+float keyFactor(Key const* keys, unsigned int keyCount, unsigned int key, double time)
+{
+    if (key + 1 >= keyCount) {
+        return 0.0f;
+    }
+    double const span = keys[key + 1].mTime - keys[key].mTime;
+    if (span <= 0.0) {
+        return 0.0f;
+    }
+    return static_cast<float>(std::min(std::max((time - keys[key].mTime) / span, 0.0), 1.0));
+}
+
+aiVector3D sampleVector(aiVectorKey const* keys, unsigned int keyCount, double time, aiVector3D const& fallback)
+{
+    if (keyCount == 0) {
+        return fallback;
+    }
+    unsigned int const key = findKey(keys, keyCount, time);
+    float const factor = keyFactor(keys, keyCount, key, time);
+    if (factor == 0.0f) {
+        return keys[key].mValue;
+    }
+    return keys[key].mValue + (keys[key + 1].mValue - keys[key].mValue) * factor;
+}
+
+aiQuaternion sampleRotation(aiQuatKey const* keys, unsigned int keyCount, double time, aiQuaternion const& fallback)
+{
+    if (keyCount == 0) {
+        return fallback;
+    }
+    unsigned int const key = findKey(keys, keyCount, time);
+    float const factor = keyFactor(keys, keyCount, key, time);
+    if (factor == 0.0f) {
+        return keys[key].mValue;
+    }
+    aiQuaternion result;
+    aiQuaternion::Interpolate(result, keys[key].mValue, keys[key + 1].mValue, factor);
+    return result.Normalize();
+}
+
+BindPose sampleComponents(aiNodeAnim const* channel, BindPose const& bindPose, double time)
+{
+    // channels may omit a component, in which case the bind transform supplies it
+    BindPose pose;
+    pose.scaling = sampleVector(channel->mScalingKeys, channel->mNumScalingKeys, time, bindPose.scaling);
+    pose.rotation = sampleRotation(channel->mRotationKeys, channel->mNumRotationKeys, time, bindPose.rotation);
+    pose.position = sampleVector(channel->mPositionKeys, channel->mNumPositionKeys, time, bindPose.position);
+    return pose;
+}
+
+aiMatrix4x4 sampleChannel(aiNodeAnim const* channel, BindPose const& bindPose, double time)
+{
+    BindPose pose = sampleComponents(channel, bindPose, time);
+    return aiMatrix4x4{ pose.scaling, pose.rotation, pose.position };
+}
+
+// Angle between the rotations two unit quaternions stand for, halved.
+float halfAngleBetween(aiQuaternion const& one, aiQuaternion const& other)
+{
+    float const dot = one.w * other.w + one.x * other.x + one.y * other.y + one.z * other.z;
+    return std::acos(std::min(std::abs(dot), 1.0f));
+}
+
+// Frobenius norm of the linear part, never below how far it stretches any vector.
+float linearNorm(aiMatrix4x4 const& m)
+{
+    return std::sqrt(m.a1 * m.a1 + m.a2 * m.a2 + m.a3 * m.a3 + m.b1 * m.b1 + m.b2 * m.b2 + m.b3 * m.b3 +
+        m.c1 * m.c1 + m.c2 * m.c2 + m.c3 * m.c3);
+}
+
+}
+
+NodeHierarchy flattenHierarchy(aiNode const* root)
+{
+    NodeHierarchy hierarchy;
+    if (root) {
+        flattenNode(root, -1, hierarchy);
+    }
+    return hierarchy;
+}
+
+AnimationBinding bindAnimation(NodeHierarchy const& hierarchy, aiAnimation const* animation)
+{
+    AnimationBinding binding;
+    binding.channels.assign(hierarchy.nodes.size(), -1);
+    binding.bindPoses.resize(hierarchy.nodes.size());
+    for (unsigned int i = 0; i < animation->mNumChannels; i++) {
+        auto const node = hierarchy.indexByName.find(std::string{ animation->mChannels[i]->mNodeName.C_Str() });
+        if (node != hierarchy.indexByName.end()) {
+            binding.channels[node->second] = static_cast<std::int32_t>(i);
+            BindPose& pose = binding.bindPoses[node->second];
+            hierarchy.nodes[node->second]->mTransformation.Decompose(pose.scaling, pose.rotation, pose.position);
+        }
+    }
+    return binding;
+}
+
+void evaluatePose(NodeHierarchy const& hierarchy, aiAnimation const* animation, AnimationBinding const& binding,
+    double time, std::vector<aiMatrix4x4>& globalTransforms)
+{
+    globalTransforms.resize(hierarchy.nodes.size());
+    for (std::size_t i = 0; i < hierarchy.nodes.size(); i++) {
+        std::int32_t const channel = binding.channels[i];
+        aiMatrix4x4 const local = channel >= 0
+            ? sampleChannel(animation->mChannels[channel], binding.bindPoses[i], time)
+            : hierarchy.nodes[i]->mTransformation;
+
+        std::int32_t const parent = hierarchy.parents[i];
+        globalTransforms[i] = parent >= 0 ? globalTransforms[parent] * local : local;
+    }
+}
+
+void evaluateMotion(NodeHierarchy const& hierarchy, aiAnimation const* animation, AnimationBinding const& binding,
+    double begin, double end, std::vector<LocalMotion>& motions)
+{
+    motions.resize(hierarchy.nodes.size());
+    double const middle = (begin + end) * 0.5;
+    for (std::size_t i = 0; i < hierarchy.nodes.size(); i++) {
+        LocalMotion& motion = motions[i];
+        std::int32_t const channel = binding.channels[i];
+        if (channel < 0) {
+            motion.middle = hierarchy.nodes[i]->mTransformation;
+            motion.stretch = linearNorm(motion.middle);
+            motion.middleScaling = aiVector3D{ 0.0f, 0.0f, 0.0f };
+            motion.scalingDeviation = aiVector3D{ 0.0f, 0.0f, 0.0f };
+            motion.translationDeviation = 0.0f;
+            motion.rotationChord = 0.0f;
+            continue;
+        }
+
+        aiNodeAnim const* const nodeAnim = animation->mChannels[channel];
+        BindPose const first = sampleComponents(nodeAnim, binding.bindPoses[i], begin);
+        BindPose center = sampleComponents(nodeAnim, binding.bindPoses[i], middle);
+        BindPose const last = sampleComponents(nodeAnim, binding.bindPoses[i], end);
+        motion.middle = aiMatrix4x4{ center.scaling, center.rotation, center.position };
+        motion.middleScaling = center.scaling;
+        motion.stretch = 0.0f;
+        for (unsigned int axis = 0; axis < 3; axis++) {
+            motion.stretch = std::max({ motion.stretch, std::abs(first.scaling[axis]), std::abs(last.scaling[axis]) });
+            motion.scalingDeviation[axis] = std::max(std::abs(first.scaling[axis] - center.scaling[axis]),
+                std::abs(last.scaling[axis] - center.scaling[axis]));
+        }
+        motion.translationDeviation = std::max((first.position - center.position).Length(), (last.position - center.position).Length());
+        // a vector turned by an angle a moves by 2 sin(a / 2), the quaternion arc is a / 2
+        float const halfAngle = std::max(halfAngleBetween(first.rotation, center.rotation), halfAngleBetween(last.rotation, center.rotation));
+        motion.rotationChord = 2.0f * std::sin(std::min(halfAngle, 1.5707964f));
+    }
+}
+
+double animationTicksPerSecond(aiAnimation const* animation)
+{
+    return animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+}
+
+Matrix3x4 toMatrix3x4(aiMatrix4x4 const& m)
+{
+    Matrix3x4 result = { {
+        { m.a1, m.a2, m.a3, m.a4 },
+        { m.b1, m.b2, m.b3, m.b4 },
+        { m.c1, m.c2, m.c3, m.c4 },
+    } };
+    return result;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assimp\scene.h>
+
+#include "data.hpp"
+
+// aiNode tree flattened depth-first, so every parent comes before its children.
+struct NodeHierarchy
+{
+    std::vector<aiNode const*> nodes;
+    std::vector<std::int32_t> parents;
+    std::unordered_map<std::string, std::uint32_t> indexByName;
+};
+
+NodeHierarchy flattenHierarchy(aiNode const* root);
+
+// Bind transform of an animated node, decomposed once for every sample of the clip.
+struct BindPose
+{
+    aiVector3D scaling;
+    aiQuaternion rotation;
+    aiVector3D position;
+};
+
+struct AnimationBinding
+{
+    // for every node of the hierarchy, the index of the aiNodeAnim channel that drives it or -1
+    std::vector<std::int32_t> channels;
+    // for every node, filled in for the animated ones only
+    std::vector<BindPose> bindPoses;
+};
+
+AnimationBinding bindAnimation(NodeHierarchy const& hierarchy, aiAnimation const* animation);
+
+// Evaluates global (model space) node transforms at the given time in ticks.
+void evaluatePose(NodeHierarchy const& hierarchy, aiAnimation const* animation, AnimationBinding const& binding,
+    double time, std::vector<aiMatrix4x4>& globalTransforms);
+
+// How far a node's local transform strays over [begin, end] from its value at the middle.
+// With no key of the clip strictly inside the interval, scaling and translation move along
+// straight lines and the rotation along one great circle arc, so the values at both ends
+// bound every value in between. Nodes without a channel don't move.
+struct LocalMotion
+{
+    aiMatrix4x4 middle;
+    aiVector3D middleScaling;
+    // largest factor the local transform stretches a vector by anywhere in the interval
+    float stretch;
+    // per component for scaling, as a distance for translation
+    aiVector3D scalingDeviation;
+    float translationDeviation;
+    // how far the rotation moves a unit vector away from where the middle rotation puts it
+    float rotationChord;
+};
+
+void evaluateMotion(NodeHierarchy const& hierarchy, aiAnimation const* animation, AnimationBinding const& binding,
+    double begin, double end, std::vector<LocalMotion>& motions);
+
+double animationTicksPerSecond(aiAnimation const* animation);
+
+Matrix3x4 toMatrix3x4(aiMatrix4x4 const& m);
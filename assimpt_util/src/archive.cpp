@@ -0,0 +1,400 @@
+#include "archive.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+#include "inflate.hpp"
+#include "trace.hpp"
+
+namespace
+{
+
+std::size_t const TAR_BLOCK = 512;
+
+std::uint16_t const ZIP_STORED = 0;
+std::uint16_t const ZIP_DEFLATED = 8;
+std::uint32_t const ZIP_LOCAL_HEADER = 0x04034b50;
+std::uint32_t const ZIP_CENTRAL_HEADER = 0x02014b50;
+std::uint32_t const ZIP_END_OF_DIRECTORY = 0x06054b50;
+std::size_t const ZIP_END_OF_DIRECTORY_SIZE = 22;
+std::size_t const ZIP_MAX_COMMENT = 0xFFFF;
+
+std::uint16_t readLe16(std::uint8_t const* p)
+{
+    return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::uint32_t readLe32(std::uint8_t const* p)
+{
+    return static_cast<std::uint32_t>(p[0]) | (static_cast<std::uint32_t>(p[1]) << 8) |
+        (static_cast<std::uint32_t>(p[2]) << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+// Tar numbers are octal text, or big-endian binary when the high bit is set (GNU).
+std::uint64_t readTarNumber(std::uint8_t const* p, std::size_t length)
+{
+    std::uint64_t value = 0;
+    if (p[0] & 0x80) {
+        for (std::size_t i = 1; i < length; i++) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+    for (std::size_t i = 0; i < length && p[i]; i++) {
+        if (p[i] >= '0' && p[i] <= '7') {
+            value = value * 8 + (p[i] - '0');
+        }
+    }
+    return value;
+}
+
+std::string readTarString(std::uint8_t const* p, std::size_t length)
+{
+    char const* text = reinterpret_cast<char const*>(p);
+    return std::string{ text, static_cast<std::size_t>(std::find(text, text + length, '\0') - text) };
+}
+
+// The path= record of a pax extended header ("<length> <key>=<value>\n" records), if any.
+bool readPaxPath(std::uint8_t const* p, std::size_t length, std::string& path)
+{
+    char const* text = reinterpret_cast<char const*>(p);
+    bool found = false;
+    std::size_t position = 0;
+    while (position < length) {
+        std::size_t recordLength = 0;
+        std::size_t cursor = position;
+        while (cursor < length && text[cursor] >= '0' && text[cursor] <= '9') {
+            recordLength = recordLength * 10 + (text[cursor] - '0');
+            cursor++;
+        }
+        if (cursor == position || cursor >= length || text[cursor] != ' ' ||
+            recordLength <= cursor - position + 1 || recordLength > length - position) {
+            break;
+        }
+        std::string const record{ text + cursor + 1, position + recordLength - cursor - 1 };
+        if (record.compare(0, 5, "path=") == 0 && record.back() == '\n') {
+            path = record.substr(5, record.size() - 6);
+            found = true;
+        }
+        position += recordLength;
+    }
+    return found;
+}
+
+std::string toLower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+}
+
+std::shared_ptr<Archive> Archive::Load(char const* archivePath)
+{
+    std::shared_ptr<MappedFile> file = MappedFile::Open(archivePath);
+    if (!file) {
+        std::cerr << "ARCHIVE::ERROR" << std::endl
+            << "Can't open the archive " << archivePath << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<Archive> archive{ new Archive{ std::move(file) } };
+    bool const isZip = archive->file_->Size() >= 4 && readLe32(archive->file_->Data()) == ZIP_LOCAL_HEADER;
+    if (!(isZip ? archive->IndexZip() : archive->IndexTar())) {
+        std::cerr << "ARCHIVE::ERROR" << std::endl
+            << "Can't index the archive " << archivePath << std::endl;
+        return nullptr;
+    }
+    return archive;
+}
+
+Archive::Archive(std::shared_ptr<MappedFile> file)
+    : file_{ std::move(file) }
+{
+}
+
+bool Archive::IndexTar()
+{
+    std::uint8_t const* data = file_->Data();
+    std::size_t const size = file_->Size();
+
+    std::string longName;
+    // POSIX pax names apply to the next entry; a path in a global (g) header would name
+    // every later entry the same, so those are skipped like the rest of that header
+    std::string paxPath;
+    std::size_t position = 0;
+    while (position + TAR_BLOCK <= size) {
+        std::uint8_t const* header = data + position;
+        if (header[0] == '\0') {
+            // two zero blocks end the archive
+            return true;
+        }
+
+        std::uint64_t const entrySize = readTarNumber(header + 124, 12);
+        char const type = static_cast<char>(header[156]);
+        std::size_t const dataOffset = position + TAR_BLOCK;
+        if (entrySize > size - dataOffset) {
+            return false;
+        }
+
+        if (type == 'L') {
+            // GNU long name, applies to the following entry
+            longName = readTarString(data + dataOffset, static_cast<std::size_t>(entrySize));
+        }
+        else if (type == 'x') {
+            readPaxPath(data + dataOffset, static_cast<std::size_t>(entrySize), paxPath);
+        }
+        else {
+            if (type == '0' || type == '\0') {
+                std::string path = !paxPath.empty() ? paxPath : longName;
+                if (path.empty()) {
+                    path = readTarString(header, 100);
+                    std::string const prefix = readTarString(header + 345, 155);
+                    if (std::memcmp(header + 257, "ustar", 5) == 0 && !prefix.empty()) {
+                        path = prefix + '/' + path;
+                    }
+                }
+                AddEntry(path, ArchiveEntry{ dataOffset, entrySize, entrySize, ZIP_STORED, false, 0 });
+            }
+            longName.clear();
+            paxPath.clear();
+        }
+
+        position = dataOffset + static_cast<std::size_t>((entrySize + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK);
+    }
+    return true;
+}
+
+bool Archive::IndexZip()
+{
+    std::uint8_t const* data = file_->Data();
+    std::size_t const size = file_->Size();
+    if (size < ZIP_END_OF_DIRECTORY_SIZE) {
+        return false;
+    }
+
+    // the end of central directory record sits behind an optional comment of up to 64k
+    std::size_t end = size - ZIP_END_OF_DIRECTORY_SIZE;
+    std::size_t const lowest = end > ZIP_MAX_COMMENT ? end - ZIP_MAX_COMMENT : 0;
+    while (readLe32(data + end) != ZIP_END_OF_DIRECTORY) {
+        if (end == lowest) {
+            return false;
+        }
+        end--;
+    }
+
+    std::size_t const entryCount = readLe16(data + end + 10);
+    std::size_t position = readLe32(data + end + 16);
+    for (std::size_t i = 0; i < entryCount; i++) {
+        if (position + 46 > size || readLe32(data + position) != ZIP_CENTRAL_HEADER) {
+            return false;
+        }
+        std::uint8_t const* header = data + position;
+        std::uint16_t const method = readLe16(header + 10);
+        std::uint32_t const crc = readLe32(header + 16);
+        std::uint32_t const compressedSize = readLe32(header + 20);
+        std::uint32_t const uncompressedSize = readLe32(header + 24);
+        std::size_t const nameLength = readLe16(header + 28);
+        std::size_t const extraLength = readLe16(header + 30);
+        std::size_t const commentLength = readLe16(header + 32);
+        std::size_t const localOffset = readLe32(header + 42);
+        if (position + 46 + nameLength > size) {
+            return false;
+        }
+        std::string const path{ reinterpret_cast<char const*>(header + 46), nameLength };
+        position += 46 + nameLength + extraLength + commentLength;
+
+        // directories have a trailing slash and no data
+        if (path.empty() || path.back() == '/') {
+            continue;
+        }
+        // local headers may carry a different extra field than the central directory
+        if (localOffset + 30 > size || readLe32(data + localOffset) != ZIP_LOCAL_HEADER) {
+            return false;
+        }
+        std::size_t const dataOffset = localOffset + 30 + readLe16(data + localOffset + 26) + readLe16(data + localOffset + 28);
+        if (dataOffset > size || compressedSize > size - dataOffset) {
+            return false;
+        }
+        AddEntry(path, ArchiveEntry{ dataOffset, uncompressedSize, compressedSize, method, true, crc });
+    }
+    return true;
+}
+
+void Archive::AddEntry(std::string const& path, ArchiveEntry const& entry)
+{
+    std::string key = normalizeArchivePath(path.c_str());
+    lowercaseKeys_.emplace(toLower(key), key);
+    entries_[std::move(key)] = entry;
+}
+
+ArchiveEntry const* Archive::Find(char const* path, std::string* key) const
+{
+    std::string normalized = normalizeArchivePath(path);
+    auto entry = entries_.find(normalized);
+    if (entry == entries_.end()) {
+        // assets authored on Windows often disagree with the bundle on case
+        auto const lowercase = lowercaseKeys_.find(toLower(normalized));
+        if (lowercase == lowercaseKeys_.end()) {
+            return nullptr;
+        }
+        entry = entries_.find(lowercase->second);
+    }
+    if (key) {
+        *key = entry->first;
+    }
+    return &entry->second;
+}
+
+Assimp::IOStream* Archive::Open(char const* path)
+{
+    ScopedTrace trace{ "io", "archive entry" };
+    std::string key;
+    ArchiveEntry const* entry = Find(path, &key);
+    if (!entry) {
+        return nullptr;
+    }
+
+    std::uint8_t const* data = file_->Data() + entry->offset;
+    if (entry->method == ZIP_STORED) {
+        if (entry->size != entry->compressedSize) {
+            std::cerr << "ARCHIVE::ERROR" << std::endl
+                << "Wrong size for the stored entry " << key << std::endl;
+            return nullptr;
+        }
+        if (!CheckCrc(key, *entry, data, static_cast<std::size_t>(entry->size))) {
+            return nullptr;
+        }
+        return new MemoryIOStream{ file_, data, static_cast<std::size_t>(entry->size) };
+    }
+    if (entry->method != ZIP_DEFLATED) {
+        std::cerr << "ARCHIVE::ERROR" << std::endl
+            << "Unsupported compression method " << entry->method << " for " << key << std::endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<std::vector<std::uint8_t> const> inflated;
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        auto const cached = inflated_.find(key);
+        if (cached != inflated_.end()) {
+            inflated = cached->second.lock();
+            if (!inflated) {
+                inflated_.erase(cached);
+            }
+        }
+    }
+    if (!inflated) {
+        auto buffer = std::make_shared<std::vector<std::uint8_t>>();
+        if (!inflateRaw(data, static_cast<std::size_t>(entry->compressedSize), static_cast<std::size_t>(entry->size), *buffer)) {
+            std::cerr << "ARCHIVE::ERROR" << std::endl
+                << "Corrupt deflate stream or wrong size in " << key << std::endl;
+            return nullptr;
+        }
+        if (entry->hasCrc && crc32(buffer->data(), buffer->size()) != entry->crc) {
+            std::cerr << "ARCHIVE::ERROR" << std::endl
+                << "CRC mismatch in " << key << std::endl;
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        // another open may have inflated it meanwhile
+        std::weak_ptr<std::vector<std::uint8_t> const>& shared = inflated_[key];
+        inflated = shared.lock();
+        if (!inflated) {
+            inflated = std::move(buffer);
+            shared = inflated;
+        }
+    }
+    return new MemoryIOStream{ inflated, inflated->data(), inflated->size() };
+}
+
+// Stored entries are served from the mapping, so the check runs on their first open only.
+bool Archive::CheckCrc(std::string const& key, ArchiveEntry const& entry, std::uint8_t const* data, std::size_t size)
+{
+    if (!entry.hasCrc) {
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        if (verified_.count(key) > 0) {
+            return true;
+        }
+    }
+    if (crc32(data, size) != entry.crc) {
+        std::cerr << "ARCHIVE::ERROR" << std::endl
+            << "CRC mismatch in " << key << std::endl;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    verified_.insert(key);
+    return true;
+}
+
+ArchiveIOSystem::ArchiveIOSystem(std::shared_ptr<Archive> archive)
+    : archive_{ std::move(archive) }
+{
+}
+
+bool ArchiveIOSystem::Exists(char const* pFile) const
+{
+    return archive_->Exists(pFile);
+}
+
+char ArchiveIOSystem::getOsSeparator() const
+{
+    return '/';
+}
+
+Assimp::IOStream* ArchiveIOSystem::Open(char const* pFile, char const* pMode)
+{
+    if (isWriteMode(pMode)) {
+        return nullptr;
+    }
+    return archive_->Open(pFile);
+}
+
+void ArchiveIOSystem::Close(Assimp::IOStream* pFile)
+{
+    delete pFile;
+}
+
+bool ArchiveIOSystem::ComparePaths(char const* one, char const* second) const
+{
+    return toLower(normalizeArchivePath(one)) == toLower(normalizeArchivePath(second));
+}
+
+std::string normalizeArchivePath(char const* path)
+{
+    std::vector<std::string> components;
+    std::string component;
+    for (char const* c = path;; c++) {
+        if (*c == '/' || *c == '\\' || *c == '\0') {
+            if (component == "..") {
+                if (!components.empty()) {
+                    components.pop_back();
+                }
+            }
+            else if (!component.empty() && component != ".") {
+                components.push_back(component);
+            }
+            component.clear();
+            if (*c == '\0') {
+                break;
+            }
+        }
+        else {
+            component += *c;
+        }
+    }
+
+    std::string normalized;
+    for (std::string const& part : components) {
+        if (!normalized.empty()) {
+            normalized += '/';
+        }
+        normalized += part;
+    }
+    return normalized;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <assimp\IOStream.hpp>
+#include <assimp\IOSystem.hpp>
+
+#include "io.hpp"
+
+struct ArchiveEntry
+{
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t compressedSize;
+    std::uint16_t method;
+    // CRC-32 of the uncompressed data, zip entries only
+    bool hasCrc;
+    std::uint32_t crc;
+};
+
+// The entries of a tar or zip bundle. The archive is memory mapped and indexed once per
+// run and shared by every import; stored entries are handed out without copying, deflated
+// entries are inflated in memory and shared by the streams open on them at the same time,
+// then dropped with the last one. The IO cache is what keeps them around for longer.
+class Archive
+{
+public:
+    static std::shared_ptr<Archive> Load(char const* archivePath);
+
+    bool Exists(char const* path) const { return Find(path, nullptr) != nullptr; }
+    // Null for a missing entry or one that fails to decompress or its CRC check.
+    Assimp::IOStream* Open(char const* path);
+
+    std::size_t EntryCount() const { return entries_.size(); }
+
+private:
+    explicit Archive(std::shared_ptr<MappedFile> file);
+
+    bool IndexTar();
+    bool IndexZip();
+    void AddEntry(std::string const& path, ArchiveEntry const& entry);
+    ArchiveEntry const* Find(char const* path, std::string* key) const;
+    bool CheckCrc(std::string const& key, ArchiveEntry const& entry, std::uint8_t const* data, std::size_t size);
+
+    std::shared_ptr<MappedFile> file_;
+    std::unordered_map<std::string, ArchiveEntry> entries_;
+    std::unordered_map<std::string, std::string> lowercaseKeys_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::weak_ptr<std::vector<std::uint8_t> const>> inflated_;
+    // stored entries whose CRC already matched
+    std::unordered_set<std::string> verified_;
+};
+
+// Serves Exists/Open from a shared Archive, one per import like the other IOSystems.
+class ArchiveIOSystem : public Assimp::IOSystem
+{
+public:
+    explicit ArchiveIOSystem(std::shared_ptr<Archive> archive);
+
+    bool Exists(char const* pFile) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(char const* pFile, char const* pMode = "rb") override;
+    void Close(Assimp::IOStream* pFile) override;
+    bool ComparePaths(char const* one, char const* second) const override;
+
+private:
+    std::shared_ptr<Archive> archive_;
+};
+
+// Forward slashes, no empty, "." or ".." components and no leading slash.
+std::string normalizeArchivePath(char const* path);
@@ -0,0 +1,275 @@
+#include "bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "parallel.hpp"
+#include "skinning.hpp"
+
+namespace
+{
+
+// a key interval is halved until no bone's allowance for motion exceeds this share of the bind pose diagonal
+float const TOLERANCE = 0.01f;
+int const MAX_SUBDIVISIONS = 8;
+
+Bounds emptyBounds()
+{
+    float const max = std::numeric_limits<float>::max();
+    return Bounds{ { max, max, max }, { -max, -max, -max } };
+}
+
+bool isEmpty(Bounds const& bounds)
+{
+    return bounds.min[0] > bounds.max[0];
+}
+
+void expand(Bounds& bounds, Bounds const& other)
+{
+    for (int i = 0; i < 3; i++) {
+        bounds.min[i] = std::min(bounds.min[i], other.min[i]);
+        bounds.max[i] = std::max(bounds.max[i], other.max[i]);
+    }
+}
+
+// Transformed box of an affine transform applied to a box (Arvo).
+Bounds transformBounds(Bounds const& bounds, SkinMatrix const& m)
+{
+    Bounds result;
+    for (int row = 0; row < 3; row++) {
+        result.min[row] = m.rows[row][3];
+        result.max[row] = m.rows[row][3];
+        for (int column = 0; column < 3; column++) {
+            float const a = m.rows[row][column] * bounds.min[column];
+            float const b = m.rows[row][column] * bounds.max[column];
+            result.min[row] += std::min(a, b);
+            result.max[row] += std::max(a, b);
+        }
+    }
+    return result;
+}
+
+void grow(Bounds& bounds, float distance)
+{
+    for (int i = 0; i < 3; i++) {
+        bounds.min[i] -= distance;
+        bounds.max[i] += distance;
+    }
+}
+
+// Length of the vector made of each axis' largest magnitude inside the box, scaled per axis.
+float reach(Bounds const& bounds, aiVector3D const& scale)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        float const extent = std::max(std::abs(bounds.min[i]), std::abs(bounds.max[i])) * scale[i];
+        sum += extent * extent;
+    }
+    return std::sqrt(sum);
+}
+
+// Sorted, unique key times (ticks) of every channel, always including 0 and the clip duration.
+std::vector<double> collectKeyTimes(aiAnimation const* animation, double duration)
+{
+    std::vector<double> times{ 0.0, duration };
+    for (unsigned int i = 0; i < animation->mNumChannels; i++) {
+        aiNodeAnim const* channel = animation->mChannels[i];
+        for (unsigned int j = 0; j < channel->mNumPositionKeys; j++) {
+            times.push_back(channel->mPositionKeys[j].mTime);
+        }
+        for (unsigned int j = 0; j < channel->mNumRotationKeys; j++) {
+            times.push_back(channel->mRotationKeys[j].mTime);
+        }
+        for (unsigned int j = 0; j < channel->mNumScalingKeys; j++) {
+            times.push_back(channel->mScalingKeys[j].mTime);
+        }
+    }
+    for (double& time : times) {
+        time = std::min(std::max(time, 0.0), duration);
+    }
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+    return times;
+}
+
+struct ClipState
+{
+    aiAnimation const* animation;
+    AnimationBinding animationBinding;
+    std::vector<double> keyTimes;
+    // one per key interval, or a single one when all keys share a time
+    std::vector<Bounds> intervalBounds;
+};
+
+struct MeshState
+{
+    NodeHierarchy const* hierarchy;
+    SkinBinding binding;
+    aiMatrix4x4 globalInverse;
+    float globalStretch;
+    float tolerance;
+    Bounds staticBounds;
+    // bind space box of the vertices each bone moves, and that box in the bone's own space
+    std::vector<Bounds> boneBounds;
+    std::vector<Bounds> boneSpaceBounds;
+};
+
+struct Scratch
+{
+    std::vector<LocalMotion> motions;
+    std::vector<aiMatrix4x4> globalTransforms;
+    std::vector<SkinMatrix> skinMatrices;
+};
+
+// Largest distance a vertex of the bone strays from where the middle pose puts it. Going up the
+// chain of ancestors, each local transform L(t) = T(t) R(t) S(t) differs from the middle one on a
+// point y by at most |dT| + |dS y| + chord |S y|, and stretches what its children strayed by at
+// most its own stretch.
+float boneDeviation(MeshState const& mesh, std::vector<LocalMotion> const& motions, std::size_t bone)
+{
+    // bones without a node keep their bind transform
+    if (mesh.binding.boneNodes[bone] >= mesh.hierarchy->nodes.size()) {
+        return 0.0f;
+    }
+    std::int32_t node = static_cast<std::int32_t>(mesh.binding.boneNodes[bone]);
+    Bounds local = mesh.boneSpaceBounds[bone];
+    float deviation = 0.0f;
+    while (node >= 0) {
+        LocalMotion const& motion = motions[node];
+        deviation = motion.stretch * deviation + motion.translationDeviation + reach(local, motion.scalingDeviation) +
+            motion.rotationChord * reach(local, motion.middleScaling);
+        local = transformBounds(local, toMatrix3x4(motion.middle));
+        node = mesh.hierarchy->parents[node];
+    }
+    return deviation * mesh.globalStretch;
+}
+
+// Bounds over [begin], [end] with no key strictly inside: the middle pose's box grown by each
+// bone's deviation, halving the interval while a deviation is above tolerance.
+Bounds intervalBounds(MeshState const& mesh, ClipState const& clip, double begin, double end, int depth, Scratch& scratch)
+{
+    evaluateMotion(*mesh.hierarchy, clip.animation, clip.animationBinding, begin, end, scratch.motions);
+    scratch.globalTransforms.resize(scratch.motions.size());
+    for (std::size_t i = 0; i < scratch.motions.size(); i++) {
+        std::int32_t const parent = mesh.hierarchy->parents[i];
+        scratch.globalTransforms[i] = parent >= 0 ? scratch.globalTransforms[parent] * scratch.motions[i].middle : scratch.motions[i].middle;
+    }
+    computeSkinMatrices(mesh.binding, scratch.globalTransforms, mesh.globalInverse, scratch.skinMatrices);
+
+    Bounds result = mesh.staticBounds;
+    for (std::size_t bone = 0; bone < mesh.boneBounds.size(); bone++) {
+        if (isEmpty(mesh.boneBounds[bone])) {
+            continue;
+        }
+        float const deviation = boneDeviation(mesh, scratch.motions, bone);
+        if (deviation > mesh.tolerance && depth < MAX_SUBDIVISIONS) {
+            double const middle = (begin + end) * 0.5;
+            Bounds first = intervalBounds(mesh, clip, begin, middle, depth + 1, scratch);
+            expand(first, intervalBounds(mesh, clip, middle, end, depth + 1, scratch));
+            return first;
+        }
+        Bounds bounds = transformBounds(mesh.boneBounds[bone], scratch.skinMatrices[bone]);
+        grow(bounds, deviation);
+        expand(result, bounds);
+    }
+    return result;
+}
+
+}
+
+std::vector<AnimatedBounds> computeAnimatedBounds(aiScene const* scene, NodeHierarchy const& hierarchy, aiMesh const* mesh,
+    bool segments)
+{
+    MeshState state;
+    state.hierarchy = &hierarchy;
+    state.binding = bindSkin(mesh, hierarchy);
+    SkinBinding const& binding = state.binding;
+
+    // unweighted vertices stay in bind pose
+    state.boneBounds.assign(binding.boneNodes.size(), emptyBounds());
+    state.staticBounds = emptyBounds();
+    Bounds bindBounds = emptyBounds();
+    for (unsigned int vertex = 0; vertex < mesh->mNumVertices; vertex++) {
+        aiVector3D const& position = mesh->mVertices[vertex];
+        Bounds const point{ { position.x, position.y, position.z }, { position.x, position.y, position.z } };
+        expand(bindBounds, point);
+        if (binding.influenceOffsets[vertex] == binding.influenceOffsets[vertex + 1]) {
+            expand(state.staticBounds, point);
+        }
+        for (std::uint32_t i = binding.influenceOffsets[vertex]; i < binding.influenceOffsets[vertex + 1]; i++) {
+            if (binding.influenceWeights[i] > 0.0f) {
+                expand(state.boneBounds[binding.influenceBones[i]], point);
+            }
+        }
+    }
+    state.boneSpaceBounds.resize(state.boneBounds.size());
+    for (std::size_t bone = 0; bone < state.boneBounds.size(); bone++) {
+        if (!isEmpty(state.boneBounds[bone])) {
+            state.boneSpaceBounds[bone] = transformBounds(state.boneBounds[bone], toMatrix3x4(binding.offsetMatrices[bone]));
+        }
+    }
+
+    state.globalInverse = scene->mRootNode->mTransformation;
+    state.globalInverse.Inverse();
+    Matrix3x4 const inverse = toMatrix3x4(state.globalInverse);
+    float stretch = 0.0f;
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            stretch += inverse.rows[row][column] * inverse.rows[row][column];
+        }
+    }
+    state.globalStretch = std::sqrt(stretch);
+    float diagonal = 0.0f;
+    if (!isEmpty(bindBounds)) {
+        for (int i = 0; i < 3; i++) {
+            diagonal += (bindBounds.max[i] - bindBounds.min[i]) * (bindBounds.max[i] - bindBounds.min[i]);
+        }
+    }
+    state.tolerance = std::sqrt(diagonal) * TOLERANCE;
+
+    std::vector<ClipState> clips(scene->mNumAnimations);
+    std::vector<std::pair<std::size_t, std::size_t>> tasks;
+    for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+        ClipState& clip = clips[i];
+        clip.animation = scene->mAnimations[i];
+        clip.animationBinding = bindAnimation(hierarchy, clip.animation);
+        clip.keyTimes = collectKeyTimes(clip.animation, std::max(clip.animation->mDuration, 0.0));
+        clip.intervalBounds.resize(std::max<std::size_t>(clip.keyTimes.size() - 1, 1));
+        for (std::size_t interval = 0; interval < clip.intervalBounds.size(); interval++) {
+            tasks.emplace_back(i, interval);
+        }
+    }
+
+    // every key interval of every clip is its own task, so long clips spread across threads as well
+    parallelFor(tasks.size(), [&](std::size_t task) {
+        ClipState& clip = clips[tasks[task].first];
+        std::size_t const interval = tasks[task].second;
+        double const begin = clip.keyTimes[interval];
+        double const end = clip.keyTimes[std::min(interval + 1, clip.keyTimes.size() - 1)];
+        Scratch scratch;
+        clip.intervalBounds[interval] = intervalBounds(state, clip, begin, end, 0, scratch);
+    });
+
+    std::vector<AnimatedBounds> result(clips.size());
+    for (std::size_t i = 0; i < clips.size(); i++) {
+        ClipState const& clip = clips[i];
+        double const ticksPerSecond = animationTicksPerSecond(clip.animation);
+
+        result[i].animation = static_cast<std::uint32_t>(i);
+        result[i].clip = emptyBounds();
+        for (Bounds const& bounds : clip.intervalBounds) {
+            expand(result[i].clip, bounds);
+        }
+
+        // both keys closing an interval are part of it
+        if (segments && clip.keyTimes.size() > 1) {
+            result[i].segments = clip.intervalBounds;
+            for (double time : clip.keyTimes) {
+                result[i].segmentTimes.push_back(static_cast<float>(time / ticksPerSecond));
+            }
+        }
+    }
+    return result;
+}
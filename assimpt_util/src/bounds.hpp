@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+#include <assimp\scene.h>
+
+#include "animation.hpp"
+#include "data.hpp"
+
+// Model space bounds of a skinned mesh for every animation of the scene. Between two keys
+// every channel moves along a line or a single arc, so each key interval is bounded by the
+// pose at its middle, each bone's box grown by how far its vertices can stray from there.
+// Intervals are halved until that allowance is small; the result holds for every time.
+// With segments enabled, bounds are also produced for every interval between keyframes.
+std::vector<AnimatedBounds> computeAnimatedBounds(aiScene const* scene, NodeHierarchy const& hierarchy, aiMesh const* mesh,
+    bool segments);
@@ -0,0 +1,108 @@
+#include "container.hpp"
+
+#include "io.hpp"
+
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+std::vector<std::uint8_t> buildContainer(std::vector<Section> const& sections)
+{
+    std::vector<std::size_t> dataOrder(sections.size());
+    for (std::size_t i = 0; i < dataOrder.size(); i++) {
+        dataOrder[i] = i;
+    }
+    return buildContainer(sections, dataOrder);
+}
+
+std::vector<std::uint8_t> buildContainer(std::vector<Section> const& sections, std::vector<std::size_t> const& dataOrder)
+{
+    ContainerHeader header;
+    header.magic = CONTAINER_MAGIC;
+    header.version = CONTAINER_VERSION;
+    header.sectionCount = static_cast<std::uint32_t>(sections.size());
+    header.reserved = 0;
+
+    std::vector<SectionEntry> entries(sections.size());
+    std::uint64_t offset = alignUp(sizeof(ContainerHeader) + sizeof(SectionEntry) * sections.size(), CONTAINER_ALIGNMENT);
+    for (std::size_t i : dataOrder) {
+        entries[i].type = static_cast<std::uint32_t>(sections[i].type);
+        entries[i].meshIndex = sections[i].meshIndex;
+        entries[i].offset = offset;
+        entries[i].size = sections[i].data.size();
+        offset = alignUp(offset + entries[i].size, CONTAINER_ALIGNMENT);
+    }
+
+    std::vector<std::uint8_t> storage;
+    storage.reserve(static_cast<std::size_t>(offset));
+    appendValue(storage, header);
+    appendBytes(storage, entries.data(), entries.size());
+    for (std::size_t i : dataOrder) {
+        storage.resize(static_cast<std::size_t>(entries[i].offset), 0);
+        appendBytes(storage, sections[i].data.data(), sections[i].data.size());
+    }
+    return storage;
+}
+
+bool parseContainer(std::uint8_t const* data, std::size_t size, std::vector<Section>& sections)
+{
+    ContainerHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != CONTAINER_MAGIC || header.version != CONTAINER_VERSION ||
+        header.sectionCount > (size - sizeof(header)) / sizeof(SectionEntry)) {
+        return false;
+    }
+
+    std::vector<SectionEntry> entries(header.sectionCount);
+    if (!entries.empty()) {
+        std::memcpy(entries.data(), data + sizeof(header), sizeof(SectionEntry) * entries.size());
+    }
+    sections.clear();
+    sections.reserve(entries.size());
+    for (SectionEntry const& entry : entries) {
+        if (entry.offset > size || entry.size > size - entry.offset) {
+            return false;
+        }
+        std::uint8_t const* begin = data + entry.offset;
+        sections.push_back(Section{ static_cast<SectionType>(entry.type), entry.meshIndex, { begin, begin + entry.size } });
+    }
+    return true;
+}
+
+bool writeOutput(char const* destName, std::vector<std::uint8_t> const& bytes)
+{
+    if (isStandardStream(destName)) {
+        if (!writeStandardOutput(bytes.data(), bytes.size())) {
+            std::cerr << "CONTAINER::ERROR" << std::endl
+                << "Can't write to stdout" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::ofstream file{ destName, std::ios::binary | std::ios::trunc };
+    file.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+    if (!file) {
+        std::cerr << "CONTAINER::ERROR" << std::endl
+            << "Can't write the file " << destName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool writeContainer(char const* destName, std::vector<Section> const& sections)
+{
+    return writeOutput(destName, buildContainer(sections));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Output file layout:
+//   ContainerHeader
+//   SectionEntry[sectionCount]
+//   section data, each section aligned to CONTAINER_ALIGNMENT
+std::uint32_t const CONTAINER_MAGIC = 0x4C545541; // "AUTL"
+std::uint32_t const CONTAINER_VERSION = 1;
+std::uint64_t const CONTAINER_ALIGNMENT = 16;
+std::uint32_t const NO_MESH = 0xFFFFFFFF;
+
+enum class SectionType : std::uint32_t
+{
+    Positions = 0,
+    Indicies = 1,
+    MorphTargets = 2,
+    VertexAnimation = 3,
+    AnimatedBounds = 4,
+    Skeleton = 5,
+    JointRemap = 6,
+    NodeTransforms = 7,
+};
+
+struct ContainerHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t sectionCount;
+    std::uint32_t reserved;
+};
+
+struct SectionEntry
+{
+    std::uint32_t type;
+    std::uint32_t meshIndex;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+struct Section
+{
+    SectionType type;
+    std::uint32_t meshIndex;
+    std::vector<std::uint8_t> data;
+};
+
+template<typename T>
+void appendBytes(std::vector<std::uint8_t>& storage, T const* data, std::size_t count)
+{
+    std::size_t const offset = storage.size();
+    storage.resize(offset + sizeof(T) * count);
+    if (count > 0) {
+        std::memcpy(storage.data() + offset, data, sizeof(T) * count);
+    }
+}
+
+template<typename T>
+void appendValue(std::vector<std::uint8_t>& storage, T const& value)
+{
+    appendBytes(storage, &value, 1);
+}
+
+std::vector<std::uint8_t> buildContainer(std::vector<Section> const& sections);
+// Same table, with the section data laid out in dataOrder (a permutation of the section indices).
+std::vector<std::uint8_t> buildContainer(std::vector<Section> const& sections, std::vector<std::size_t> const& dataOrder);
+// Inverse of buildContainer, false when the bytes are not a well-formed container.
+bool parseContainer(std::uint8_t const* data, std::size_t size, std::vector<Section>& sections);
+
+// destName "-" streams the bytes to stdout.
+bool writeOutput(char const* destName, std::vector<std::uint8_t> const& bytes);
+bool writeContainer(char const* destName, std::vector<Section> const& sections);
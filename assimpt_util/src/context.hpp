@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+
+#include "archive.hpp"
+#include "deps.hpp"
+#include "importer.hpp"
+#include "iocache.hpp"
+#include "outputcache.hpp"
+#include "timing.hpp"
+#include "writer.hpp"
+
+// State shared by every processModel call of one run, possibly across worker threads.
+struct ProcessContext
+{
+    std::shared_ptr<IOCache> ioCache;
+    // indexed once per run, its inflated entries are shared by every import
+    std::shared_ptr<Archive> archive;
+    FileStamp archiveStamp;
+    std::shared_ptr<ImporterPool> importers;
+    std::shared_ptr<OutputCache> outputCache;
+    std::shared_ptr<DependencyDatabase> dependencies;
+    std::shared_ptr<TimingSink> timings;
+    std::shared_ptr<OutputWriter> writer;
+};
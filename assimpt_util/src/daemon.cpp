@@ -0,0 +1,340 @@
+#include "daemon.hpp"
+
+#include <iostream>
+
+#ifdef _WIN32
+
+bool runDaemon(char const*, std::size_t, ConvertFunction const&, OutputWriter&)
+{
+    std::cerr << "DAEMON::ERROR" << std::endl
+        << "Unix domain sockets are not supported on this platform" << std::endl;
+    return false;
+}
+
+#else
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "parallel.hpp"
+
+namespace
+{
+
+class Connection
+{
+public:
+    explicit Connection(int socket) : socket_{ socket } { }
+    Connection(Connection const&) = delete;
+    Connection& operator=(Connection const&) = delete;
+    ~Connection() { ::close(socket_); }
+
+    int Socket() const { return socket_; }
+
+    // Takes the next complete request already received, if any.
+    bool NextLine(std::string& line)
+    {
+        std::size_t const end = buffer_.find('\n');
+        if (end == std::string::npos) {
+            return false;
+        }
+        line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 1);
+        return true;
+    }
+
+    // Receives once, returns false once the client hung up.
+    bool Fill()
+    {
+        char chunk[4096];
+        ssize_t const received = recv(socket_, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        buffer_.append(chunk, static_cast<std::size_t>(received));
+        return true;
+    }
+
+    bool HasLine() const { return buffer_.find('\n') != std::string::npos; }
+
+    bool Send(void const* data, std::size_t size)
+    {
+        char const* bytes = static_cast<char const*>(data);
+        while (size > 0) {
+            ssize_t const sent = send(socket_, bytes, size, 0);
+            if (sent <= 0) {
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<std::size_t>(sent);
+        }
+        return true;
+    }
+
+    bool Send(std::string const& text)
+    {
+        return Send(text.data(), text.size());
+    }
+
+private:
+    int socket_;
+    std::string buffer_;
+};
+
+// Idle connections wait in the listening thread's poll(), a readable one is queued for the
+// workers, which serve a single request and hand it back, so an idle client holds no worker.
+struct DaemonState
+{
+    int listener;
+    // written to wake the poll() when a connection goes back to idle or the daemon stops
+    int wake[2];
+    std::atomic<bool> stopping{ false };
+
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<Connection*> pending;
+    std::vector<Connection*> idle;
+    std::unordered_map<Connection*, std::unique_ptr<Connection>> open;
+};
+
+void wakeListener(DaemonState& state)
+{
+    char const signal = 0;
+    ssize_t const written = write(state.wake[1], &signal, 1);
+    // a full pipe already holds a wake-up
+    static_cast<void>(written);
+}
+
+// Returns false once the client asked the daemon to stop.
+bool serveRequest(Connection& connection, std::string const& request, ConvertFunction const& convert, OutputWriter& writer)
+{
+    if (request == "shutdown") {
+        connection.Send(std::string{ "ok\n" });
+        return false;
+    }
+
+    std::vector<std::uint8_t> container;
+    if (request.compare(0, 7, "inline ") == 0) {
+        std::string const source = request.substr(7);
+        if (!convert(source, container)) {
+            connection.Send("error can't convert " + source + "\n");
+            return true;
+        }
+        if (connection.Send("ok " + std::to_string(container.size()) + "\n")) {
+            connection.Send(container.data(), container.size());
+        }
+        return true;
+    }
+
+    if (request.compare(0, 8, "convert ") == 0) {
+        std::size_t const tab = request.find('\t', 8);
+        if (tab == std::string::npos) {
+            connection.Send(std::string{ "error expected convert <source>\\t<dest>\n" });
+            return true;
+        }
+        std::string const source = request.substr(8, tab - 8);
+        std::string const dest = request.substr(tab + 1);
+        if (!convert(source, container)) {
+            connection.Send("error can't convert " + source + "\n");
+        }
+        else if (!writer.Write(dest.c_str(), container)) {
+            connection.Send("error can't write " + dest + "\n");
+        }
+        else {
+            connection.Send("ok " + dest + "\n");
+        }
+        return true;
+    }
+
+    connection.Send("error unknown request " + request + "\n");
+    return true;
+}
+
+void serveConnections(DaemonState& state, ConvertFunction const& convert, OutputWriter& writer)
+{
+    ParallelWorkerScope worker;
+    for (;;) {
+        Connection* connection;
+        {
+            std::unique_lock<std::mutex> lock{ state.mutex };
+            state.available.wait(lock, [&] { return state.stopping || !state.pending.empty(); });
+            if (state.stopping) {
+                return;
+            }
+            connection = state.pending.front();
+            state.pending.pop_front();
+        }
+
+        std::string request;
+        bool received = connection->NextLine(request);
+        bool const open = received || connection->Fill();
+        if (open && !received) {
+            received = connection->NextLine(request);
+        }
+        if (received && !serveRequest(*connection, request, convert, writer)) {
+            {
+                std::lock_guard<std::mutex> lock{ state.mutex };
+                state.stopping = true;
+            }
+            state.available.notify_all();
+            wakeListener(state);
+            continue;
+        }
+        std::lock_guard<std::mutex> lock{ state.mutex };
+        if (!open) {
+            state.open.erase(connection);
+        }
+        else if (connection->HasLine()) {
+            state.pending.push_back(connection);
+            state.available.notify_one();
+        }
+        else {
+            state.idle.push_back(connection);
+            wakeListener(state);
+        }
+    }
+}
+
+}
+
+bool runDaemon(char const* socketPath, std::size_t workerCount, ConvertFunction const& convert, OutputWriter& writer)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (std::strlen(socketPath) >= sizeof(address.sun_path)) {
+        std::cerr << "DAEMON::ERROR" << std::endl
+            << "Socket path too long " << socketPath << std::endl;
+        return false;
+    }
+    std::strcpy(address.sun_path, socketPath);
+
+    // a client hanging up mid-reply must not kill the daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    DaemonState state;
+    if (pipe(state.wake) != 0) {
+        std::cerr << "DAEMON::ERROR" << std::endl
+            << "Can't create a pipe" << std::endl;
+        return false;
+    }
+    fcntl(state.wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(state.wake[1], F_SETFL, O_NONBLOCK);
+    state.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (state.listener < 0) {
+        std::cerr << "DAEMON::ERROR" << std::endl
+            << "Can't create a socket" << std::endl;
+        ::close(state.wake[0]);
+        ::close(state.wake[1]);
+        return false;
+    }
+    // a stale socket from an earlier run is replaced, anything else at the path is left alone
+    struct stat existing;
+    if (lstat(socketPath, &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << "DAEMON::ERROR" << std::endl
+                << socketPath << " exists and is not a socket" << std::endl;
+            ::close(state.listener);
+            ::close(state.wake[0]);
+            ::close(state.wake[1]);
+            return false;
+        }
+        unlink(socketPath);
+    }
+    if (bind(state.listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0 ||
+        listen(state.listener, SOMAXCONN) != 0) {
+        std::cerr << "DAEMON::ERROR" << std::endl
+            << "Can't listen on " << socketPath << std::endl;
+        ::close(state.listener);
+        ::close(state.wake[0]);
+        ::close(state.wake[1]);
+        return false;
+    }
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < std::max<std::size_t>(workerCount, 1); i++) {
+        workers.emplace_back(serveConnections, std::ref(state), std::cref(convert), std::ref(writer));
+    }
+
+    std::vector<pollfd> polled;
+    std::vector<Connection*> polledConnections;
+    while (!state.stopping) {
+        polled.assign({ pollfd{ state.listener, POLLIN, 0 }, pollfd{ state.wake[0], POLLIN, 0 } });
+        {
+            std::lock_guard<std::mutex> lock{ state.mutex };
+            polledConnections = state.idle;
+        }
+        for (Connection* connection : polledConnections) {
+            polled.push_back(pollfd{ connection->Socket(), POLLIN, 0 });
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (polled[1].revents != 0) {
+            char drained[64];
+            while (read(state.wake[0], drained, sizeof(drained)) > 0) {
+            }
+        }
+        std::lock_guard<std::mutex> lock{ state.mutex };
+        for (std::size_t i = 0; i < polledConnections.size(); i++) {
+            if (polled[i + 2].revents != 0) {
+                state.idle.erase(std::find(state.idle.begin(), state.idle.end(), polledConnections[i]));
+                state.pending.push_back(polledConnections[i]);
+                state.available.notify_one();
+            }
+        }
+        if (polled[0].revents != 0) {
+            int const client = accept(state.listener, nullptr, nullptr);
+            if (client >= 0) {
+                std::unique_ptr<Connection> connection{ new Connection{ client } };
+                state.idle.push_back(connection.get());
+                state.open.emplace(connection.get(), std::move(connection));
+            }
+            else if (errno != EINTR && errno != ECONNABORTED) {
+                break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ state.mutex };
+        state.stopping = true;
+        // unblocks workers still sending to a client that stopped reading
+        for (auto const& connection : state.open) {
+            shutdown(connection.second->Socket(), SHUT_RDWR);
+        }
+    }
+    state.available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    state.open.clear();
+
+    ::close(state.listener);
+    ::close(state.wake[0]);
+    ::close(state.wake[1]);
+    unlink(socketPath);
+    return true;
+}
+
+#endif
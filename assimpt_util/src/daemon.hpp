@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "writer.hpp"
+
+// Converts one source into a serialized container, returns false on failure.
+using ConvertFunction = std::function<bool(std::string const& sourceName, std::vector<std::uint8_t>& container)>;
+
+// Serves conversion jobs over a Unix domain socket until a client sends "shutdown".
+// Each connection may send any number of newline terminated requests:
+//   convert <source>\t<dest>   writes the container to dest through writer, replies "ok <dest>\n"
+//   inline <source>            replies "ok <size>\n" followed by the container bytes
+//   shutdown                   replies "ok\n" and stops accepting connections
+// Failures reply "error <message>\n". Requests are served one at a time by workerCount threads,
+// a connection waiting for its next request holds none of them.
+bool runDaemon(char const* socketPath, std::size_t workerCount, ConvertFunction const& convert, OutputWriter& writer);
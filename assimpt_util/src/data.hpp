@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 struct Vertex
@@ -9,6 +10,12 @@ struct Vertex
     float uv[2];
 };
 
+// Row-major 3x4 affine matrix, the last row (0, 0, 0, 1) is implied.
+struct Matrix3x4
+{
+    float rows[3][4];
+};
+
 struct Pos
 {
     float x, y, z;
@@ -24,10 +31,89 @@ struct UV
     float u, v;
 };
 
+// Sparse blend shape: only vertices that actually move are stored.
+// Deltas are quantized to int16, delta = quantized * scale.
+struct MorphTarget
+{
+    std::vector<std::uint32_t> indicies;
+    std::vector<std::int16_t> positionDeltas;
+    std::vector<std::int16_t> normalDeltas;
+    float positionScale;
+    float normalScale;
+};
+
+// Vertex animation texture for one clip: frameCount rows of vertexCount texels.
+// Positions are unorm16 within [boundsMin, boundsMax], normals snorm8, both padded to 4 channels.
+struct VertexAnimation
+{
+    std::uint32_t animation;
+    std::uint32_t frameCount;
+    std::uint32_t vertexCount;
+    float frameRate;
+    float boundsMin[3];
+    float boundsMax[3];
+    std::vector<std::uint16_t> positions;
+    std::vector<std::int8_t> normals;
+};
+
+struct Bounds
+{
+    float min[3];
+    float max[3];
+};
+
+// Bounds of a skinned mesh over one clip. Segment i covers [segmentTimes[i], segmentTimes[i + 1]] seconds.
+struct AnimatedBounds
+{
+    std::uint32_t animation;
+    Bounds clip;
+    std::vector<float> segmentTimes;
+    std::vector<Bounds> segments;
+};
+
+// Joints sorted parent before child, parents[i] < i or -1 for roots.
+struct Skeleton
+{
+    std::vector<std::uint32_t> nameHashes;
+    std::vector<std::int32_t> parents;
+    std::vector<Matrix3x4> localBindTransforms;
+    std::vector<Matrix3x4> inverseBindMatrices;
+};
+
+std::uint8_t const TRANSFORM_ROTATION_INDEX_MASK = 0x3;
+std::uint8_t const TRANSFORM_NON_UNIFORM_SCALE = 0x4;
+std::uint8_t const TRANSFORM_MATRIX_FALLBACK = 0x8;
+
+// Node transforms decomposed into translation, rotation and scale, one array per component.
+// Rotations are smallest-three quantized: the dropped component index lives in the low flag bits.
+// Nodes flagged TRANSFORM_NON_UNIFORM_SCALE take their scale from nonUniformScales (xyz, in node order),
+// nodes flagged TRANSFORM_MATRIX_FALLBACK could not be decomposed (shear) and use fallbackMatrices.
+struct NodeTransforms
+{
+    std::vector<std::uint32_t> nameHashes;
+    std::vector<std::int32_t> parents;
+    std::vector<std::uint8_t> flags;
+    std::vector<float> translationX;
+    std::vector<float> translationY;
+    std::vector<float> translationZ;
+    std::vector<std::int16_t> rotationA;
+    std::vector<std::int16_t> rotationB;
+    std::vector<std::int16_t> rotationC;
+    std::vector<float> scales;
+    std::vector<float> nonUniformScales;
+    std::vector<Matrix3x4> fallbackMatrices;
+};
+
 struct Mesh
 {
     std::vector<Pos> vertices;
     std::vector<std::size_t> indicies;
+    std::vector<MorphTarget> morphTargets;
+    std::vector<VertexAnimation> vertexAnimations;
+    std::vector<AnimatedBounds> animatedBounds;
+    std::vector<std::uint32_t> jointRemap;
+
+    unsigned int sourceMesh;
 
     //int material;
 };
@@ -0,0 +1,180 @@
+#include "deps.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "io.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+
+std::vector<std::string> splitTabs(std::string const& line)
+{
+    std::vector<std::string> fields;
+    std::istringstream stream{ line };
+    std::string field;
+    while (std::getline(stream, field, '\t')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+}
+
+bool fileStamp(char const* path, FileStamp& stamp)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        return false;
+    }
+    stamp.size = (static_cast<std::uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    stamp.modified = static_cast<std::int64_t>((static_cast<std::uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime);
+    return true;
+#else
+    struct stat status;
+    if (stat(path, &status) != 0 || !S_ISREG(status.st_mode)) {
+        return false;
+    }
+    stamp.size = static_cast<std::uint64_t>(status.st_size);
+    // nanoseconds, a save within the same second still counts as a change
+    stamp.modified = static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+    return true;
+#endif
+}
+
+DependencyDatabase::DependencyDatabase(std::string path)
+    : path_{ std::move(path) }
+{
+    std::ifstream file{ path_ };
+    std::string line;
+    Entry* current = nullptr;
+    while (std::getline(file, line)) {
+        std::vector<std::string> const fields = splitTabs(line);
+        if (fields.size() == 4 && fields[0] == "output") {
+            Entry& record = records_[fields[1]];
+            record.source = fields[2];
+            record.fingerprint = std::strtoull(fields[3].c_str(), nullptr, 16);
+            record.inputs.clear();
+            current = &record;
+        }
+        else if (fields.size() == 4 && fields[0] == "input" && current) {
+            FileStamp stamp;
+            stamp.size = std::strtoull(fields[2].c_str(), nullptr, 10);
+            stamp.modified = std::strtoll(fields[3].c_str(), nullptr, 10);
+            current->inputs.emplace_back(fields[1], stamp);
+        }
+    }
+}
+
+bool DependencyDatabase::Save() const
+{
+    if (path_.empty()) {
+        return true;
+    }
+
+    // written aside and renamed, an interrupted save keeps the previous database
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    std::string const temporary = path_ + ".tmp";
+    {
+        std::ofstream file{ temporary, std::ios::trunc };
+        for (auto const& record : records_) {
+            char fingerprint[17];
+            std::snprintf(fingerprint, sizeof(fingerprint), "%016llx", static_cast<unsigned long long>(record.second.fingerprint));
+            file << "output\t" << record.first << '\t' << record.second.source << '\t' << fingerprint << '\n';
+            for (auto const& input : record.second.inputs) {
+                file << "input\t" << input.first << '\t' << input.second.size << '\t' << input.second.modified << '\n';
+            }
+        }
+        if (!file) {
+            std::cerr << "DEPS::ERROR" << std::endl
+                << "Can't write the dependency database " << temporary << std::endl;
+            return false;
+        }
+    }
+    if (!replaceFile(temporary, path_)) {
+        std::cerr << "DEPS::ERROR" << std::endl
+            << "Can't replace the dependency database " << path_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DependencyDatabase::UpToDate(std::string const& dest, std::string const& source, std::uint64_t fingerprint,
+    std::vector<std::string> const& outputFiles)
+{
+    Entry record;
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        auto const found = records_.find(dest);
+        if (found == records_.end()) {
+            rebuilt_++;
+            return false;
+        }
+        record = found->second;
+    }
+
+    bool upToDate = record.source == source && record.fingerprint == fingerprint;
+    FileStamp stamp;
+    for (std::size_t i = 0; upToDate && i < outputFiles.size(); i++) {
+        upToDate = fileStamp(outputFiles[i].c_str(), stamp);
+    }
+    for (std::size_t i = 0; upToDate && i < record.inputs.size(); i++) {
+        upToDate = fileStamp(record.inputs[i].first.c_str(), stamp) && stamp == record.inputs[i].second;
+    }
+
+    if (upToDate) {
+        upToDate_++;
+    }
+    else {
+        rebuilt_++;
+    }
+    return upToDate;
+}
+
+void DependencyDatabase::Record(std::string const& dest, std::string const& source, std::uint64_t fingerprint,
+    std::map<std::string, FileStamp> const& inputs)
+{
+    Entry record;
+    record.source = source;
+    record.fingerprint = fingerprint;
+    record.inputs.assign(inputs.begin(), inputs.end());
+
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    records_[dest] = std::move(record);
+}
+
+void DependencyDatabase::Forget(std::string const& dest)
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    records_.erase(dest);
+}
+
+std::vector<std::string> DependencyDatabase::Inputs(std::string const& dest) const
+{
+    std::vector<std::string> inputs;
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    auto const found = records_.find(dest);
+    if (found != records_.end()) {
+        for (auto const& input : found->second.inputs) {
+            inputs.push_back(input.first);
+        }
+    }
+    return inputs;
+}
+
+DependencyStats DependencyDatabase::Stats() const
+{
+    return DependencyStats{ upToDate_, rebuilt_ };
+}
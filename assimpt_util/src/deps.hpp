@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Size and modification time, enough to tell an input changed without reading it.
+struct FileStamp
+{
+    std::uint64_t size;
+    std::int64_t modified;
+
+    bool operator==(FileStamp const& other) const { return size == other.size && modified == other.modified; }
+};
+
+bool fileStamp(char const* path, FileStamp& stamp);
+
+struct DependencyStats
+{
+    std::uint64_t upToDate;
+    std::uint64_t rebuilt;
+};
+
+// Every input file each output was last built from, persisted between runs.
+// An output is up to date when its options are unchanged, its files exist and
+// no recorded input changed size or modification time.
+// Text format, one record per output followed by its inputs:
+//   output<TAB>dest<TAB>source<TAB>fingerprint
+//   input<TAB>path<TAB>size<TAB>modified
+class DependencyDatabase
+{
+public:
+    explicit DependencyDatabase(std::string path);
+
+    // An empty path keeps the database in memory only.
+    bool Save() const;
+
+    bool UpToDate(std::string const& dest, std::string const& source, std::uint64_t fingerprint, std::vector<std::string> const& outputFiles);
+    // inputs holds every file the output was built from, stamped before the conversion read it.
+    void Record(std::string const& dest, std::string const& source, std::uint64_t fingerprint, std::map<std::string, FileStamp> const& inputs);
+    void Forget(std::string const& dest);
+    std::vector<std::string> Inputs(std::string const& dest) const;
+
+    DependencyStats Stats() const;
+
+private:
+    struct Entry
+    {
+        std::string source;
+        std::uint64_t fingerprint;
+        std::vector<std::pair<std::string, FileStamp>> inputs;
+    };
+
+    std::string const path_;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> records_;
+
+    std::atomic<std::uint64_t> upToDate_{ 0 };
+    std::atomic<std::uint64_t> rebuilt_{ 0 };
+};
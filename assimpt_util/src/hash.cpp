@@ -0,0 +1,126 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+namespace
+{
+
+std::uint64_t const PRIME1 = 11400714785074694791ull;
+std::uint64_t const PRIME2 = 14029467366897019727ull;
+std::uint64_t const PRIME3 = 1609587929392839161ull;
+std::uint64_t const PRIME4 = 9650029242287828579ull;
+std::uint64_t const PRIME5 = 2870177450012600261ull;
+
+std::uint64_t rotateLeft(std::uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+std::uint64_t read64(std::uint8_t const* data)
+{
+    std::uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+std::uint32_t read32(std::uint8_t const* data)
+{
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+std::uint64_t round(std::uint64_t lane, std::uint64_t input)
+{
+    lane += input * PRIME2;
+    lane = rotateLeft(lane, 31);
+    return lane * PRIME1;
+}
+
+std::uint64_t mergeRound(std::uint64_t hash, std::uint64_t lane)
+{
+    hash ^= round(0, lane);
+    return hash * PRIME1 + PRIME4;
+}
+
+}
+
+ContentHash::ContentHash(std::uint64_t seed)
+    : seed_{ seed }
+    , lanes_{ seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1 }
+    , length_{ 0 }
+    , buffered_{ 0 }
+{
+}
+
+void ContentHash::Update(void const* data, std::size_t size)
+{
+    std::uint8_t const* bytes = static_cast<std::uint8_t const*>(data);
+    length_ += size;
+
+    if (buffered_ + size < sizeof(buffer_)) {
+        std::memcpy(buffer_ + buffered_, bytes, size);
+        buffered_ += size;
+        return;
+    }
+
+    if (buffered_ > 0) {
+        std::size_t const fill = sizeof(buffer_) - buffered_;
+        std::memcpy(buffer_ + buffered_, bytes, fill);
+        for (int i = 0; i < 4; i++) {
+            lanes_[i] = round(lanes_[i], read64(buffer_ + i * 8));
+        }
+        bytes += fill;
+        size -= fill;
+        buffered_ = 0;
+    }
+
+    // whole stripes straight from the input
+    while (size >= 32) {
+        for (int i = 0; i < 4; i++) {
+            lanes_[i] = round(lanes_[i], read64(bytes + i * 8));
+        }
+        bytes += 32;
+        size -= 32;
+    }
+
+    std::memcpy(buffer_, bytes, size);
+    buffered_ = size;
+}
+
+std::uint64_t ContentHash::Digest() const
+{
+    std::uint64_t hash;
+    if (length_ >= 32) {
+        hash = rotateLeft(lanes_[0], 1) + rotateLeft(lanes_[1], 7) + rotateLeft(lanes_[2], 12) + rotateLeft(lanes_[3], 18);
+        for (int i = 0; i < 4; i++) {
+            hash = mergeRound(hash, lanes_[i]);
+        }
+    }
+    else {
+        hash = seed_ + PRIME5;
+    }
+    hash += length_;
+
+    std::size_t offset = 0;
+    for (; offset + 8 <= buffered_; offset += 8) {
+        hash ^= round(0, read64(buffer_ + offset));
+        hash = rotateLeft(hash, 27) * PRIME1 + PRIME4;
+    }
+    if (offset + 4 <= buffered_) {
+        hash ^= read32(buffer_ + offset) * PRIME1;
+        hash = rotateLeft(hash, 23) * PRIME2 + PRIME3;
+        offset += 4;
+    }
+    for (; offset < buffered_; offset++) {
+        hash ^= buffer_[offset] * PRIME5;
+        hash = rotateLeft(hash, 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
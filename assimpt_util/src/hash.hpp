@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// FNV-1a, used for stable 32-bit name ids.
+inline std::uint32_t hashName(char const* data, std::size_t length)
+{
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < length; i++) {
+        hash ^= static_cast<std::uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Streaming XXH64, used to key cached outputs by file content.
+class ContentHash
+{
+public:
+    explicit ContentHash(std::uint64_t seed = 0);
+
+    void Update(void const* data, std::size_t size);
+    std::uint64_t Digest() const;
+
+    template<typename T>
+    void UpdateValue(T const& value)
+    {
+        Update(&value, sizeof(T));
+    }
+
+private:
+    std::uint64_t seed_;
+    std::uint64_t lanes_[4];
+    std::uint64_t length_;
+    std::uint8_t buffer_[32];
+    std::size_t buffered_;
+};
@@ -0,0 +1,98 @@
+#include "importer.hpp"
+
+#include "hash.hpp"
+
+void ImporterProperties::Apply(Assimp::Importer& importer) const
+{
+    for (auto const& property : integers) {
+        importer.SetPropertyInteger(property.first.c_str(), property.second);
+    }
+    for (auto const& property : floats) {
+        importer.SetPropertyFloat(property.first.c_str(), property.second);
+    }
+    for (auto const& property : strings) {
+        importer.SetPropertyString(property.first.c_str(), property.second);
+    }
+}
+
+std::uint64_t ImporterProperties::Fingerprint() const
+{
+    ContentHash hash;
+    for (auto const& property : integers) {
+        hash.Update(property.first.c_str(), property.first.size() + 1);
+        hash.UpdateValue(property.second);
+    }
+    for (auto const& property : floats) {
+        hash.Update(property.first.c_str(), property.first.size() + 1);
+        hash.UpdateValue(property.second);
+    }
+    for (auto const& property : strings) {
+        hash.Update(property.first.c_str(), property.first.size() + 1);
+        hash.Update(property.second.c_str(), property.second.size() + 1);
+    }
+    return hash.Digest();
+}
+
+ImporterPool::ImporterPool(ImporterProperties properties)
+    : properties_{ std::move(properties) }
+{
+}
+
+Assimp::Importer& ImporterPool::ForThread()
+{
+    std::thread::id const thread = std::this_thread::get_id();
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        auto const found = importers_.find(thread);
+        if (found != importers_.end()) {
+            return *found->second;
+        }
+    }
+
+    // constructed outside the lock, only this thread ever inserts its own key
+    std::unique_ptr<Assimp::Importer> importer{ new Assimp::Importer };
+    properties_.Apply(*importer);
+
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return *importers_.emplace(thread, std::move(importer)).first->second;
+}
+
+PooledImporter::PooledImporter(ImporterPool& pool)
+    : importer_{ pool.ForThread() }
+{
+}
+
+PooledImporter::~PooledImporter()
+{
+    importer_.FreeScene();
+    installIOHandler(importer_, nullptr);
+    installProgressHandler(importer_, nullptr);
+}
+
+void installProgressHandler(Assimp::Importer& importer, Assimp::ProgressHandler* handler)
+{
+    if (handler) {
+        // like IO handlers, a replaced progress handler is deleted by the importer
+        importer.SetProgressHandler(handler);
+        return;
+    }
+    if (!importer.IsDefaultProgressHandler()) {
+        Assimp::ProgressHandler* previous = importer.GetProgressHandler();
+        importer.SetProgressHandler(nullptr);
+        delete previous;
+    }
+}
+
+void installIOHandler(Assimp::Importer& importer, Assimp::IOSystem* ioSystem)
+{
+    if (ioSystem) {
+        // the importer deletes the handler it replaces
+        importer.SetIOHandler(ioSystem);
+        return;
+    }
+    if (!importer.IsDefaultIOHandler()) {
+        Assimp::IOSystem* previous = importer.GetIOHandler();
+        importer.SetIOHandler(nullptr);
+        delete previous;
+    }
+}
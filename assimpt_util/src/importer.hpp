@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <assimp\Importer.hpp>
+#include <assimp\IOSystem.hpp>
+#include <assimp\ProgressHandler.hpp>
+
+// Importer configuration shared by every importer of one run.
+struct ImporterProperties
+{
+    std::map<std::string, int> integers;
+    std::map<std::string, float> floats;
+    std::map<std::string, std::string> strings;
+
+    void Apply(Assimp::Importer& importer) const;
+    // Content hash of every property, part of the output cache key.
+    std::uint64_t Fingerprint() const;
+};
+
+// One importer per worker thread, configured once, so construction, loader
+// registration and property setup are paid once per thread instead of per file.
+class ImporterPool
+{
+public:
+    explicit ImporterPool(ImporterProperties properties);
+
+    // The calling thread's importer, created on first use.
+    Assimp::Importer& ForThread();
+
+    ImporterProperties const& Properties() const { return properties_; }
+
+private:
+    ImporterProperties properties_;
+    std::mutex mutex_;
+    std::map<std::thread::id, std::unique_ptr<Assimp::Importer>> importers_;
+};
+
+// Borrows the calling thread's importer for one job and resets it on destruction:
+// the scene is freed and the job's IO and progress handlers dropped, so nothing outlives the job.
+class PooledImporter
+{
+public:
+    explicit PooledImporter(ImporterPool& pool);
+    PooledImporter(PooledImporter const&) = delete;
+    PooledImporter& operator=(PooledImporter const&) = delete;
+    ~PooledImporter();
+
+    Assimp::Importer& operator*() { return importer_; }
+    Assimp::Importer* operator->() { return &importer_; }
+
+private:
+    Assimp::Importer& importer_;
+};
+
+// Replaces the importer's progress handler; nullptr restores the default one.
+void installProgressHandler(Assimp::Importer& importer, Assimp::ProgressHandler* handler);
+
+// Replaces the importer's IO handler; nullptr restores the default one.
+// Reused importers need this because SetIOHandler(nullptr) does not delete a custom handler.
+void installIOHandler(Assimp::Importer& importer, Assimp::IOSystem* ioSystem);
@@ -0,0 +1,353 @@
+#include "inflate.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+int const MAX_BITS = 15;
+int const MAX_LENGTH_CODES = 286;
+int const MAX_DISTANCE_CODES = 30;
+int const FIXED_LENGTH_CODES = 288;
+
+std::uint16_t const LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+std::uint16_t const LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+std::uint16_t const DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+std::uint16_t const DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Canonical Huffman table: number of codes per length and symbols ordered by code.
+struct Huffman
+{
+    std::uint16_t counts[MAX_BITS + 1];
+    std::uint16_t symbols[FIXED_LENGTH_CODES];
+};
+
+struct BitReader
+{
+    std::uint8_t const* data;
+    std::size_t size;
+    std::size_t position;
+    std::uint32_t buffer;
+    int count;
+};
+
+bool readBits(BitReader& reader, int need, int& value)
+{
+    std::uint32_t buffer = reader.buffer;
+    while (reader.count < need) {
+        if (reader.position == reader.size) {
+            return false;
+        }
+        buffer |= static_cast<std::uint32_t>(reader.data[reader.position++]) << reader.count;
+        reader.count += 8;
+    }
+    value = static_cast<int>(buffer & ((1u << need) - 1));
+    reader.buffer = buffer >> need;
+    reader.count -= need;
+    return true;
+}
+
+// Returns false for incomplete or over-subscribed code sets, lengths of zero mean "unused".
+bool buildHuffman(Huffman& huffman, std::uint16_t const* lengths, int symbolCount, bool allowIncomplete)
+{
+    for (int length = 0; length <= MAX_BITS; length++) {
+        huffman.counts[length] = 0;
+    }
+    for (int symbol = 0; symbol < symbolCount; symbol++) {
+        huffman.counts[lengths[symbol]]++;
+    }
+    if (huffman.counts[0] == symbolCount) {
+        return true;
+    }
+
+    int left = 1;
+    for (int length = 1; length <= MAX_BITS; length++) {
+        left <<= 1;
+        left -= huffman.counts[length];
+        if (left < 0) {
+            return false;
+        }
+    }
+
+    std::uint16_t offsets[MAX_BITS + 1];
+    offsets[1] = 0;
+    for (int length = 1; length < MAX_BITS; length++) {
+        offsets[length + 1] = offsets[length] + huffman.counts[length];
+    }
+    for (int symbol = 0; symbol < symbolCount; symbol++) {
+        if (lengths[symbol] != 0) {
+            huffman.symbols[offsets[lengths[symbol]]++] = static_cast<std::uint16_t>(symbol);
+        }
+    }
+    return left == 0 || allowIncomplete;
+}
+
+bool decodeSymbol(BitReader& reader, Huffman const& huffman, int& symbol)
+{
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int length = 1; length <= MAX_BITS; length++) {
+        int bit;
+        if (!readBits(reader, 1, bit)) {
+            return false;
+        }
+        code |= bit;
+        int const count = huffman.counts[length];
+        if (code - count < first) {
+            symbol = huffman.symbols[index + (code - first)];
+            return true;
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return false;
+}
+
+bool inflateStored(BitReader& reader, std::size_t limit, std::vector<std::uint8_t>& output)
+{
+    reader.buffer = 0;
+    reader.count = 0;
+    if (reader.size - reader.position < 4) {
+        return false;
+    }
+    std::uint8_t const* header = reader.data + reader.position;
+    unsigned int const length = header[0] | (header[1] << 8);
+    unsigned int const complement = header[2] | (header[3] << 8);
+    if (length != (~complement & 0xFFFF)) {
+        return false;
+    }
+    reader.position += 4;
+    if (reader.size - reader.position < length || length > limit - output.size()) {
+        return false;
+    }
+    output.insert(output.end(), reader.data + reader.position, reader.data + reader.position + length);
+    reader.position += length;
+    return true;
+}
+
+// start is where this stream's output begins, limit where it has to end.
+bool inflateCodes(BitReader& reader, Huffman const& lengthCodes, Huffman const& distanceCodes, std::size_t start,
+    std::size_t limit, std::vector<std::uint8_t>& output)
+{
+    for (;;) {
+        int symbol;
+        if (!decodeSymbol(reader, lengthCodes, symbol)) {
+            return false;
+        }
+        if (symbol < 256) {
+            if (output.size() == limit) {
+                return false;
+            }
+            output.push_back(static_cast<std::uint8_t>(symbol));
+            continue;
+        }
+        if (symbol == 256) {
+            return true;
+        }
+
+        symbol -= 257;
+        if (symbol >= 29) {
+            return false;
+        }
+        int extra;
+        if (!readBits(reader, LENGTH_EXTRA[symbol], extra)) {
+            return false;
+        }
+        std::size_t const length = LENGTH_BASE[symbol] + extra;
+
+        if (!decodeSymbol(reader, distanceCodes, symbol) || symbol >= 30) {
+            return false;
+        }
+        if (!readBits(reader, DISTANCE_EXTRA[symbol], extra)) {
+            return false;
+        }
+        std::size_t const distance = DISTANCE_BASE[symbol] + extra;
+        if (distance > output.size() - start || length > limit - output.size()) {
+            return false;
+        }
+
+        // copies may overlap their own output, so go byte by byte
+        std::size_t from = output.size() - distance;
+        for (std::size_t i = 0; i < length; i++) {
+            output.push_back(output[from++]);
+        }
+    }
+}
+
+bool inflateFixed(BitReader& reader, std::size_t start, std::size_t limit, std::vector<std::uint8_t>& output)
+{
+    static Huffman lengthCodes;
+    static Huffman distanceCodes;
+    static bool const built = [] {
+        std::uint16_t lengths[FIXED_LENGTH_CODES];
+        for (int symbol = 0; symbol < FIXED_LENGTH_CODES; symbol++) {
+            lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+        }
+        buildHuffman(lengthCodes, lengths, FIXED_LENGTH_CODES, false);
+        for (int symbol = 0; symbol < MAX_DISTANCE_CODES; symbol++) {
+            lengths[symbol] = 5;
+        }
+        buildHuffman(distanceCodes, lengths, MAX_DISTANCE_CODES, true);
+        return true;
+    }();
+    (void)built;
+    return inflateCodes(reader, lengthCodes, distanceCodes, start, limit, output);
+}
+
+bool inflateDynamic(BitReader& reader, std::size_t start, std::size_t limit, std::vector<std::uint8_t>& output)
+{
+    static int const ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    int lengthCount;
+    int distanceCount;
+    int codeCount;
+    if (!readBits(reader, 5, lengthCount) || !readBits(reader, 5, distanceCount) || !readBits(reader, 4, codeCount)) {
+        return false;
+    }
+    lengthCount += 257;
+    distanceCount += 1;
+    codeCount += 4;
+    if (lengthCount > MAX_LENGTH_CODES || distanceCount > MAX_DISTANCE_CODES) {
+        return false;
+    }
+
+    std::uint16_t lengths[MAX_LENGTH_CODES + MAX_DISTANCE_CODES] = {};
+    for (int i = 0; i < codeCount; i++) {
+        int length;
+        if (!readBits(reader, 3, length)) {
+            return false;
+        }
+        lengths[ORDER[i]] = static_cast<std::uint16_t>(length);
+    }
+
+    Huffman lengthCodes;
+    Huffman distanceCodes;
+    if (!buildHuffman(lengthCodes, lengths, 19, false)) {
+        return false;
+    }
+
+    int index = 0;
+    while (index < lengthCount + distanceCount) {
+        int symbol;
+        if (!decodeSymbol(reader, lengthCodes, symbol)) {
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[index++] = static_cast<std::uint16_t>(symbol);
+            continue;
+        }
+
+        std::uint16_t length = 0;
+        int repeat;
+        if (symbol == 16) {
+            if (index == 0 || !readBits(reader, 2, repeat)) {
+                return false;
+            }
+            length = lengths[index - 1];
+            repeat += 3;
+        }
+        else if (symbol == 17) {
+            if (!readBits(reader, 3, repeat)) {
+                return false;
+            }
+            repeat += 3;
+        }
+        else {
+            if (!readBits(reader, 7, repeat)) {
+                return false;
+            }
+            repeat += 11;
+        }
+        if (index + repeat > lengthCount + distanceCount) {
+            return false;
+        }
+        while (repeat-- > 0) {
+            lengths[index++] = length;
+        }
+    }
+
+    // a block without an end-of-block code can never terminate
+    if (lengths[256] == 0) {
+        return false;
+    }
+    int usedLengthCodes = 0;
+    for (int i = 0; i < lengthCount; i++) {
+        usedLengthCodes += lengths[i] != 0;
+    }
+    if (!buildHuffman(lengthCodes, lengths, lengthCount, usedLengthCodes == 1)) {
+        return false;
+    }
+    if (!buildHuffman(distanceCodes, lengths + lengthCount, distanceCount, true)) {
+        return false;
+    }
+    return inflateCodes(reader, lengthCodes, distanceCodes, start, limit, output);
+}
+
+}
+
+bool inflateRaw(std::uint8_t const* data, std::size_t size, std::size_t outputSize, std::vector<std::uint8_t>& output)
+{
+    BitReader reader{ data, size, 0, 0, 0 };
+    std::size_t const start = output.size();
+    std::size_t const limit = start + outputSize;
+    // deflate expands at most 1032:1, a header claiming more can't be trusted for a reserve
+    output.reserve(start + std::min(outputSize, size * 1032));
+
+    int last;
+    do {
+        int type;
+        if (!readBits(reader, 1, last) || !readBits(reader, 2, type)) {
+            return false;
+        }
+        bool ok;
+        switch (type) {
+        case 0:
+            ok = inflateStored(reader, limit, output);
+            break;
+        case 1:
+            ok = inflateFixed(reader, start, limit, output);
+            break;
+        case 2:
+            ok = inflateDynamic(reader, start, limit, output);
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        if (!ok) {
+            return false;
+        }
+    } while (!last);
+    return output.size() == limit;
+}
+
+std::uint32_t crc32(std::uint8_t const* data, std::size_t size)
+{
+    static std::uint32_t const* const table = [] {
+        static std::uint32_t values[256];
+        for (std::uint32_t i = 0; i < 256; i++) {
+            std::uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            values[i] = value;
+        }
+        return values;
+    }();
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Decodes a raw DEFLATE (RFC 1951) stream, as stored in zip entries, appending to output.
+// Fails unless the stream decodes to exactly outputSize bytes, and stops as soon as it would
+// exceed them, so a small entry can't claim unbounded memory.
+bool inflateRaw(std::uint8_t const* data, std::size_t size, std::size_t outputSize, std::vector<std::uint8_t>& output);
+
+// CRC-32 as used by zip (reflected, polynomial 0xEDB88320).
+std::uint32_t crc32(std::uint8_t const* data, std::size_t size);
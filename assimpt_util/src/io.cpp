@@ -0,0 +1,459 @@
+#include "io.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "hash.hpp"
+#include "trace.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+std::shared_ptr<MappedFile> MappedFile::Open(char const* path)
+{
+    HANDLE const file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> mapped{ new MappedFile };
+    mapped->file_ = file;
+    mapped->size_ = static_cast<std::size_t>(size.QuadPart);
+    if (mapped->size_ == 0) {
+        return mapped;
+    }
+
+    mapped->mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapped->mapping_) {
+        return nullptr;
+    }
+    mapped->data_ = static_cast<std::uint8_t const*>(MapViewOfFile(mapped->mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!mapped->data_) {
+        return nullptr;
+    }
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    if (file_) {
+        CloseHandle(file_);
+    }
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::Open(char const* path)
+{
+    int const file = ::open(path, O_RDONLY);
+    if (file < 0) {
+        return nullptr;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode)) {
+        ::close(file);
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> mapped{ new MappedFile };
+    mapped->size_ = static_cast<std::size_t>(status.st_size);
+    if (mapped->size_ > 0) {
+        void* const data = mmap(nullptr, mapped->size_, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            ::close(file);
+            return nullptr;
+        }
+        madvise(data, mapped->size_, MADV_SEQUENTIAL);
+        mapped->data_ = static_cast<std::uint8_t const*>(data);
+    }
+    // the mapping keeps the file referenced, the descriptor is no longer needed
+    ::close(file);
+    return mapped;
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_) {
+        munmap(const_cast<std::uint8_t*>(data_), size_);
+    }
+}
+
+#endif
+
+MemoryIOStream::MemoryIOStream(std::shared_ptr<void const> owner, std::uint8_t const* data, std::size_t size)
+    : owner_{ std::move(owner) }
+    , data_{ data }
+    , size_{ size }
+    , position_{ 0 }
+{
+}
+
+size_t MemoryIOStream::Read(void* pvBuffer, size_t pSize, size_t pCount)
+{
+    if (pSize == 0 || pCount == 0) {
+        return 0;
+    }
+    // like fread, only whole elements are reported
+    std::size_t const count = std::min(pCount, (size_ - position_) / pSize);
+    std::memcpy(pvBuffer, data_ + position_, count * pSize);
+    position_ += count * pSize;
+    return count;
+}
+
+size_t MemoryIOStream::Write(void const*, size_t, size_t)
+{
+    return 0;
+}
+
+aiReturn MemoryIOStream::Seek(size_t pOffset, aiOrigin pOrigin)
+{
+    std::size_t position;
+    switch (pOrigin) {
+    case aiOrigin_SET:
+        position = pOffset;
+        break;
+    case aiOrigin_CUR:
+        position = position_ + pOffset;
+        break;
+    case aiOrigin_END:
+        // the offset is negative, unsigned wrap-around lands on size_ - |offset|
+        position = size_ + pOffset;
+        break;
+    default:
+        return aiReturn_FAILURE;
+    }
+    if (position > size_) {
+        return aiReturn_FAILURE;
+    }
+    position_ = position;
+    return aiReturn_SUCCESS;
+}
+
+size_t MemoryIOStream::Tell() const
+{
+    return position_;
+}
+
+size_t MemoryIOStream::FileSize() const
+{
+    return size_;
+}
+
+void MemoryIOStream::Flush()
+{
+}
+
+namespace
+{
+
+bool isRegularFile(char const* path)
+{
+#ifdef _WIN32
+    DWORD const attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat status;
+    return stat(path, &status) == 0 && S_ISREG(status.st_mode);
+#endif
+}
+
+char osSeparator()
+{
+#ifdef _WIN32
+    return '\\';
+#else
+    return '/';
+#endif
+}
+
+bool seekFile(std::FILE* file, std::int64_t offset, int origin)
+{
+#ifdef _WIN32
+    return _fseeki64(file, offset, origin) == 0;
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+}
+
+std::int64_t tellFile(std::FILE* file)
+{
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return static_cast<std::int64_t>(ftello(file));
+#endif
+}
+
+}
+
+bool MappedIOSystem::Exists(char const* pFile) const
+{
+    return isRegularFile(pFile);
+}
+
+char MappedIOSystem::getOsSeparator() const
+{
+    return osSeparator();
+}
+
+Assimp::IOStream* MappedIOSystem::Open(char const* pFile, char const* pMode)
+{
+    // importers only ever read, writing is left to the exporter's own IO
+    if (isWriteMode(pMode)) {
+        return nullptr;
+    }
+    ScopedTrace trace{ "io", "map file" };
+    std::shared_ptr<MappedFile> mapped = MappedFile::Open(pFile);
+    if (!mapped) {
+        return nullptr;
+    }
+    std::uint8_t const* data = mapped->Data();
+    std::size_t const size = mapped->Size();
+    return new MemoryIOStream{ std::move(mapped), data, size };
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* pFile)
+{
+    delete pFile;
+}
+
+FileIOStream::FileIOStream(std::FILE* file)
+    : file_{ file }
+    , size_{ 0 }
+{
+    if (seekFile(file_, 0, SEEK_END)) {
+        std::int64_t const size = tellFile(file_);
+        size_ = size > 0 ? static_cast<std::size_t>(size) : 0;
+    }
+    seekFile(file_, 0, SEEK_SET);
+}
+
+FileIOStream::~FileIOStream()
+{
+    std::fclose(file_);
+}
+
+size_t FileIOStream::Read(void* pvBuffer, size_t pSize, size_t pCount)
+{
+    return std::fread(pvBuffer, pSize, pCount, file_);
+}
+
+size_t FileIOStream::Write(void const*, size_t, size_t)
+{
+    return 0;
+}
+
+aiReturn FileIOStream::Seek(size_t pOffset, aiOrigin pOrigin)
+{
+    int origin;
+    switch (pOrigin) {
+    case aiOrigin_SET:
+        origin = SEEK_SET;
+        break;
+    case aiOrigin_CUR:
+        origin = SEEK_CUR;
+        break;
+    case aiOrigin_END:
+        origin = SEEK_END;
+        break;
+    default:
+        return aiReturn_FAILURE;
+    }
+    // CUR and END offsets may be negative, passed in wrapped around like MemoryIOStream's
+    return seekFile(file_, static_cast<std::int64_t>(pOffset), origin) ? aiReturn_SUCCESS : aiReturn_FAILURE;
+}
+
+size_t FileIOStream::Tell() const
+{
+    std::int64_t const position = tellFile(file_);
+    return position > 0 ? static_cast<std::size_t>(position) : 0;
+}
+
+size_t FileIOStream::FileSize() const
+{
+    return size_;
+}
+
+void FileIOStream::Flush()
+{
+}
+
+bool FileIOSystem::Exists(char const* pFile) const
+{
+    return isRegularFile(pFile);
+}
+
+char FileIOSystem::getOsSeparator() const
+{
+    return osSeparator();
+}
+
+Assimp::IOStream* FileIOSystem::Open(char const* pFile, char const* pMode)
+{
+    if (isWriteMode(pMode)) {
+        return nullptr;
+    }
+    std::FILE* const file = std::fopen(pFile, "rb");
+    if (!file) {
+        return nullptr;
+    }
+    return new FileIOStream{ file };
+}
+
+void FileIOSystem::Close(Assimp::IOStream* pFile)
+{
+    delete pFile;
+}
+
+TrackingIOSystem::TrackingIOSystem(Assimp::IOSystem* inner)
+    : inner_{ inner }
+{
+}
+
+TrackingIOSystem::~TrackingIOSystem()
+{
+    delete inner_;
+}
+
+bool TrackingIOSystem::Exists(char const* pFile) const
+{
+    return inner_->Exists(pFile);
+}
+
+char TrackingIOSystem::getOsSeparator() const
+{
+    return inner_->getOsSeparator();
+}
+
+Assimp::IOStream* TrackingIOSystem::Open(char const* pFile, char const* pMode)
+{
+    if (isWriteMode(pMode)) {
+        return inner_->Open(pFile, pMode);
+    }
+    // stamped before it is opened, a later edit then always shows as a change
+    TrackedFile file;
+    auto found = opened_.find(pFile);
+    if (found == opened_.end()) {
+        file.stamped = fileStamp(pFile, file.stamp);
+        file.hashed = false;
+    }
+    Assimp::IOStream* stream = inner_->Open(pFile, pMode);
+    if (!stream) {
+        return nullptr;
+    }
+    if (found == opened_.end()) {
+        found = opened_.emplace(pFile, file).first;
+    }
+    if (hashFiles_ && !found->second.hashed) {
+        found->second.hashed = hashFile(*inner_, pFile, found->second.hash);
+    }
+    return stream;
+}
+
+void TrackingIOSystem::Close(Assimp::IOStream* pFile)
+{
+    inner_->Close(pFile);
+}
+
+bool TrackingIOSystem::ComparePaths(char const* one, char const* second) const
+{
+    return inner_->ComparePaths(one, second);
+}
+
+void TrackingIOSystem::Restart(bool hashFiles)
+{
+    opened_.clear();
+    hashFiles_ = hashFiles;
+}
+
+bool replaceFile(std::string const& from, std::string const& to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool hashFile(Assimp::IOSystem& io, char const* path, std::uint64_t& hash)
+{
+    Assimp::IOStream* stream = io.Open(path, "rb");
+    if (!stream) {
+        return false;
+    }
+
+    ContentHash content;
+    std::unique_ptr<std::uint8_t[]> chunk{ new std::uint8_t[1 << 16] };
+    for (;;) {
+        std::size_t const read = stream->Read(chunk.get(), 1, 1 << 16);
+        if (read == 0) {
+            break;
+        }
+        content.Update(chunk.get(), read);
+    }
+    io.Close(stream);
+
+    hash = content.Digest();
+    return true;
+}
+
+bool isWriteMode(char const* mode)
+{
+    return std::strpbrk(mode, "wa+") != nullptr;
+}
+
+bool isStandardStream(char const* name)
+{
+    return std::strcmp(name, "-") == 0;
+}
+
+bool readStandardInput(std::vector<std::uint8_t>& buffer)
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    std::size_t const chunk = 1 << 20;
+    for (;;) {
+        std::size_t const offset = buffer.size();
+        buffer.resize(offset + chunk);
+        std::size_t const read = std::fread(buffer.data() + offset, 1, chunk, stdin);
+        buffer.resize(offset + read);
+        if (read < chunk) {
+            return !std::ferror(stdin);
+        }
+    }
+}
+
+bool writeStandardOutput(std::uint8_t const* data, std::size_t size)
+{
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    return std::fwrite(data, 1, size, stdout) == size && std::fflush(stdout) == 0;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <assimp\IOStream.hpp>
+#include <assimp\IOSystem.hpp>
+
+#include "deps.hpp"
+
+// Read-only memory mapping of a whole file, hinted for sequential access.
+class MappedFile
+{
+public:
+    static std::shared_ptr<MappedFile> Open(char const* path);
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    ~MappedFile();
+
+    std::uint8_t const* Data() const { return data_; }
+    std::size_t Size() const { return size_; }
+
+private:
+    MappedFile() = default;
+
+    std::uint8_t const* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+// Read-only stream over a block of memory; owner keeps the block alive.
+class MemoryIOStream : public Assimp::IOStream
+{
+public:
+    MemoryIOStream(std::shared_ptr<void const> owner, std::uint8_t const* data, std::size_t size);
+
+    size_t Read(void* pvBuffer, size_t pSize, size_t pCount) override;
+    size_t Write(void const* pvBuffer, size_t pSize, size_t pCount) override;
+    aiReturn Seek(size_t pOffset, aiOrigin pOrigin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+private:
+    std::shared_ptr<void const> owner_;
+    std::uint8_t const* data_;
+    std::size_t size_;
+    std::size_t position_;
+};
+
+// Serves every read-only Open from a memory mapping instead of buffered stdio.
+class MappedIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(char const* pFile) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(char const* pFile, char const* pMode = "rb") override;
+    void Close(Assimp::IOStream* pFile) override;
+};
+
+// Read-only stream over buffered stdio, what --no-mmap reads through.
+class FileIOStream : public Assimp::IOStream
+{
+public:
+    explicit FileIOStream(std::FILE* file);
+    ~FileIOStream();
+
+    size_t Read(void* pvBuffer, size_t pSize, size_t pCount) override;
+    size_t Write(void const* pvBuffer, size_t pSize, size_t pCount) override;
+    aiReturn Seek(size_t pOffset, aiOrigin pOrigin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+private:
+    std::FILE* file_;
+    std::size_t size_;
+};
+
+// MappedIOSystem's counterpart without mappings, so the wrappers (IO cache, tracking) have
+// a concrete system to decorate when mapped IO is turned off.
+class FileIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(char const* pFile) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(char const* pFile, char const* pMode = "rb") override;
+    void Close(Assimp::IOStream* pFile) override;
+};
+
+// A file as a tracked import first opened it, stamped (and hashed when asked) before the
+// importer read a byte, so an edit made during the conversion is never recorded as built.
+struct TrackedFile
+{
+    // false for paths that aren't files on disk, such as archive entries
+    bool stamped;
+    FileStamp stamp;
+    bool hashed;
+    std::uint64_t hash;
+};
+
+// Decorates another IOSystem (taking ownership of it) and records every file the
+// import actually read, so outputs can be tied to their side files.
+class TrackingIOSystem : public Assimp::IOSystem
+{
+public:
+    explicit TrackingIOSystem(Assimp::IOSystem* inner);
+    ~TrackingIOSystem();
+
+    bool Exists(char const* pFile) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(char const* pFile, char const* pMode = "rb") override;
+    void Close(Assimp::IOStream* pFile) override;
+    bool ComparePaths(char const* one, char const* second) const override;
+
+    // Forgets the files opened so far; from now on each one is also hashed when first read
+    // if hashFiles is set.
+    void Restart(bool hashFiles);
+
+    // The wrapped system, for reads that must not be recorded.
+    Assimp::IOSystem& Inner() { return *inner_; }
+    std::map<std::string, TrackedFile> const& OpenedFiles() const { return opened_; }
+
+private:
+    Assimp::IOSystem* inner_;
+    bool hashFiles_ = false;
+    std::map<std::string, TrackedFile> opened_;
+};
+
+// Renames from over to, replacing an existing file in one step.
+bool replaceFile(std::string const& from, std::string const& to);
+
+// Hashes a whole file read through io, false when it can't be opened.
+bool hashFile(Assimp::IOSystem& io, char const* path, std::uint64_t& hash);
+
+bool isWriteMode(char const* mode);
+
+// "-" as a source or destination name stands for stdin / stdout.
+bool isStandardStream(char const* name);
+
+// Reads stdin (a pipe, socket or file) in binary mode until end of stream.
+bool readStandardInput(std::vector<std::uint8_t>& buffer);
+bool writeStandardOutput(std::uint8_t const* data, std::size_t size);
@@ -0,0 +1,191 @@
+#include "iocache.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+#include "io.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace
+{
+
+std::string listingKey(std::string name)
+{
+#ifdef _WIN32
+    // NTFS lookups are case-insensitive
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+#endif
+    return name;
+}
+
+void splitPath(std::string const& path, std::string& directory, std::string& name)
+{
+    std::size_t const separator = path.find_last_of("/\\");
+    if (separator == std::string::npos) {
+        directory = ".";
+        name = path;
+    }
+    else {
+        directory = separator == 0 ? path.substr(0, 1) : path.substr(0, separator);
+        name = path.substr(separator + 1);
+    }
+}
+
+// Returns false when the directory can't be listed, in which case the caller falls back to probing.
+bool listDirectory(std::string const& directory, std::unordered_set<std::string>& names)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE const find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            names.insert(listingKey(entry.cFileName));
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+    return true;
+#else
+    DIR* const dir = opendir(directory.c_str());
+    if (!dir) {
+        return false;
+    }
+    while (dirent const* entry = readdir(dir)) {
+        // DT_UNKNOWN (some network file systems) is kept, the name still has to match exactly
+        if (entry->d_type != DT_DIR) {
+            names.insert(entry->d_name);
+        }
+    }
+    closedir(dir);
+    return true;
+#endif
+}
+
+}
+
+IOCache::IOCache(bool listDirectories)
+    : listDirectories_{ listDirectories }
+{
+}
+
+bool IOCache::Exists(std::string const& path, std::function<bool()> const& probe)
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        auto const cached = exists_.find(path);
+        if (cached != exists_.end()) {
+            existsHits_++;
+            return cached->second;
+        }
+    }
+    existsMisses_++;
+
+    bool exists = false;
+    std::shared_ptr<Listing const> listing;
+    if (listDirectories_) {
+        std::string directory;
+        std::string name;
+        splitPath(path, directory, name);
+        listing = DirectoryListing(directory);
+        if (listing) {
+            exists = listing->count(listingKey(name)) > 0;
+        }
+    }
+    if (!listing) {
+        exists = probe();
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    exists_[path] = exists;
+    return exists;
+}
+
+void IOCache::RecordMissing(std::string const& path)
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    exists_[path] = false;
+}
+
+IOCacheStats IOCache::Stats() const
+{
+    return IOCacheStats{ existsHits_, existsMisses_, listingHits_, listingMisses_, openSkips_ };
+}
+
+std::shared_ptr<IOCache::Listing const> IOCache::DirectoryListing(std::string const& directory)
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        auto const cached = listings_.find(directory);
+        if (cached != listings_.end()) {
+            listingHits_++;
+            return cached->second;
+        }
+    }
+    listingMisses_++;
+
+    // listed outside the lock, two workers racing on one directory just list it twice
+    auto names = std::make_shared<Listing>();
+    std::shared_ptr<Listing const> listing;
+    if (listDirectory(directory, *names)) {
+        listing = std::move(names);
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    return listings_.emplace(directory, listing).first->second;
+}
+
+CachingIOSystem::CachingIOSystem(Assimp::IOSystem* inner, std::shared_ptr<IOCache> cache)
+    : inner_{ inner }
+    , cache_{ std::move(cache) }
+{
+}
+
+CachingIOSystem::~CachingIOSystem()
+{
+    delete inner_;
+}
+
+bool CachingIOSystem::Exists(char const* pFile) const
+{
+    return cache_->Exists(pFile, [&]() { return inner_->Exists(pFile); });
+}
+
+char CachingIOSystem::getOsSeparator() const
+{
+    return inner_->getOsSeparator();
+}
+
+Assimp::IOStream* CachingIOSystem::Open(char const* pFile, char const* pMode)
+{
+    if (isWriteMode(pMode)) {
+        return inner_->Open(pFile, pMode);
+    }
+    if (!Exists(pFile)) {
+        cache_->SkipOpen();
+        return nullptr;
+    }
+    Assimp::IOStream* stream = inner_->Open(pFile, pMode);
+    if (!stream) {
+        cache_->RecordMissing(pFile);
+    }
+    return stream;
+}
+
+void CachingIOSystem::Close(Assimp::IOStream* pFile)
+{
+    inner_->Close(pFile);
+}
+
+bool CachingIOSystem::ComparePaths(char const* one, char const* second) const
+{
+    return inner_->ComparePaths(one, second);
+}
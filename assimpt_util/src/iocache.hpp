@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <assimp\IOStream.hpp>
+#include <assimp\IOSystem.hpp>
+
+struct IOCacheStats
+{
+    std::uint64_t existsHits;
+    std::uint64_t existsMisses;
+    std::uint64_t listingHits;
+    std::uint64_t listingMisses;
+    std::uint64_t openSkips;
+};
+
+// Existence checks and directory listings memoized for a whole batch run, shared by all workers.
+// With listDirectories set, a miss lists the parent directory once and answers every later
+// probe into that directory from the listing instead of asking the file system again.
+class IOCache
+{
+public:
+    explicit IOCache(bool listDirectories);
+
+    bool Exists(std::string const& path, std::function<bool()> const& probe);
+    void RecordMissing(std::string const& path);
+    void SkipOpen() { openSkips_++; }
+
+    IOCacheStats Stats() const;
+
+private:
+    using Listing = std::unordered_set<std::string>;
+
+    std::shared_ptr<Listing const> DirectoryListing(std::string const& directory);
+
+    bool const listDirectories_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, bool> exists_;
+    std::unordered_map<std::string, std::shared_ptr<Listing const>> listings_;
+
+    std::atomic<std::uint64_t> existsHits_{ 0 };
+    std::atomic<std::uint64_t> existsMisses_{ 0 };
+    std::atomic<std::uint64_t> listingHits_{ 0 };
+    std::atomic<std::uint64_t> listingMisses_{ 0 };
+    std::atomic<std::uint64_t> openSkips_{ 0 };
+};
+
+// Decorates another IOSystem (taking ownership of it) with a shared IOCache.
+// Opens of files the cache knows to be missing never reach the wrapped system.
+class CachingIOSystem : public Assimp::IOSystem
+{
+public:
+    CachingIOSystem(Assimp::IOSystem* inner, std::shared_ptr<IOCache> cache);
+    ~CachingIOSystem();
+
+    bool Exists(char const* pFile) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(char const* pFile, char const* pMode = "rb") override;
+    void Close(Assimp::IOStream* pFile) override;
+    bool ComparePaths(char const* one, char const* second) const override;
+
+private:
+    Assimp::IOSystem* inner_;
+    std::shared_ptr<IOCache> cache_;
+};
@@ -2,38 +2,670 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
 
 #include <assimp\Importer.hpp>
 #include <assimp\scene.h>
 #include <assimp\postprocess.h>
+#include <assimp\config.h>
+#include <assimp\version.h>
 
 #include "data.hpp"
+#include "container.hpp"
+#include "options.hpp"
+#include "animation.hpp"
+#include "vat.hpp"
+#include "bounds.hpp"
+#include "skeleton.hpp"
+#include "transforms.hpp"
+#include "io.hpp"
+#include "archive.hpp"
+#include "context.hpp"
+#include "parallel.hpp"
+#include "importer.hpp"
+#include "daemon.hpp"
+#include "targets.hpp"
+#include "outputcache.hpp"
+#include "hash.hpp"
+#include "deps.hpp"
+#include "watch.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
+#include "pipeline.hpp"
+#include "pak.hpp"
+#include "patch.hpp"
 
-void processModel(char const* sourceName, char const* destName);
+// Shared by every target, post-process steps beyond these come from the target profiles.
+unsigned int const IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_ConvertToLeftHanded;
 
-void recursiveMeshParse(aiNode const* node, aiScene const* scene, std::vector<Mesh>& storage);
+// One asset on its way from the source to its written outputs, handed from stage to stage
+// in pipelined batches.
+struct ModelJob
+{
+    std::string sourceName;
+    std::string destName;
+    std::vector<std::string> destNames;
+    bool tracked = false;
+    // nothing to convert, which isn't a failure
+    bool upToDate = false;
+    std::uint64_t fingerprint = 0;
+
+    // imported but not yet built into sections
+    std::unique_ptr<aiScene> scene;
+    std::vector<std::vector<Section>> outputs;
+    // stamped before they were read, stamped is false when one of them couldn't be
+    std::map<std::string, FileStamp> inputs;
+    bool stamped = false;
+
+    // store the outputs in the cache under cacheKey once they are built
+    bool keyed = false;
+    std::uint64_t cacheKey = 0;
+    std::vector<CachedSideFile> sideFiles;
+
+    // timings of every stage, in the pipeline only
+    std::unique_ptr<AssetRecord> asset;
+};
+
+bool parseOptions(int argc, char** argv, ProcessOptions& options, std::vector<char const*>& paths);
+
+bool convertModel(char const* sourceName, ProcessOptions const& options, ProcessContext& context,
+    std::vector<std::vector<Section>>& outputs, std::map<std::string, FileStamp>& inputs);
+void buildSections(aiScene const* scene, ProcessOptions const& options, std::vector<Section>& sections, aiScene* releasable = nullptr);
+void appendMeshSections(Mesh const& mesh, std::uint32_t meshIndex, std::vector<Section>& sections);
+void releaseUnusedSceneData(aiScene* scene);
+void releaseAnimations(aiScene* scene);
+bool processModel(char const* sourceName, char const* destName, ProcessOptions const& options, ProcessContext& context);
+bool processPipeline(std::vector<std::pair<std::string, std::string>> const& jobs, ProcessOptions const& options, ProcessContext& context);
+bool startModel(ModelJob& job, ProcessOptions const& options, ProcessContext& context);
+bool importModel(ModelJob& job, ProcessOptions const& options, ProcessContext& context);
+void buildOutputs(ModelJob& job, ProcessOptions const& options);
+void storeOutputs(ModelJob& job, ProcessContext& context);
+bool finishModel(ModelJob& job, ProcessContext& context);
+bool processBatch(ProcessOptions const& options);
+bool processSingle(ProcessOptions const& options, char const* sourceName, char const* destName);
+bool processDaemon(ProcessOptions const& options);
+bool processWatch(ProcessOptions const& options, std::vector<char const*> const& paths);
+bool readBatchList(std::string const& listName, std::vector<std::pair<std::string, std::string>>& jobs);
+std::shared_ptr<ImporterPool> createImporterPool(ProcessOptions const& options);
+std::shared_ptr<OutputCache> createOutputCache(ProcessOptions const& options);
+bool loadArchive(ProcessOptions const& options, ProcessContext& context);
+std::shared_ptr<DependencyDatabase> loadDependencies(ProcessOptions const& options);
+std::shared_ptr<TimingSink> createTimingSink(ProcessOptions const& options);
+std::uint64_t outputFingerprint(ProcessOptions const& options, ImporterProperties const& properties);
+std::uint64_t outputCacheKey(std::uint64_t sourceHash, std::uint64_t fingerprint);
+void printOutputCacheStats(OutputCache const& cache);
+void printDependencyStats(DependencyDatabase const& dependencies);
+void printPakStats(PakWriter const& pak);
+
+void recursiveMeshCollect(aiNode const* node, std::vector<unsigned int>& meshes);
 
 Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+MorphTarget processMorphTarget(aiMesh const* mesh, aiAnimMesh const* animMesh);
 
 void serializeMeshPositions(Mesh const& mesh, std::vector<std::uint8_t>& storage);
 void serializeMeshIndicies(Mesh const& mesh, std::vector<std::uint8_t>& storage);
+void serializeMeshMorphTargets(Mesh const& mesh, std::vector<std::uint8_t>& storage);
+void serializeVertexAnimation(VertexAnimation const& animation, std::vector<std::uint8_t>& storage);
+void serializeAnimatedBounds(AnimatedBounds const& bounds, std::vector<std::uint8_t>& storage);
+void serializeSkeleton(Skeleton const& skeleton, std::vector<std::uint8_t>& storage);
+void serializeNodeTransforms(NodeTransforms const& transforms, std::vector<std::uint8_t>& storage);
 
 int main(int argc, char** argv)
 {
-    std::vector<Mesh> meshes;
+    ProcessOptions options;
+    std::vector<char const*> paths;
+
+    // false once an option or a build operation failed, scripts see it in the exit code
+    bool succeeded = parseOptions(argc, argv, options, paths);
+    if (succeeded) {
+        if (!options.timingsPath.empty()) {
+            attachTimingLog();
+        }
+        if (!options.tracePath.empty()) {
+            startTrace();
+        }
+        if (!options.daemonSocket.empty()) {
+            succeeded = processDaemon(options);
+        }
+        else if (options.watch) {
+            succeeded = processWatch(options, paths);
+        }
+        else if (!options.batchList.empty()) {
+            succeeded = processBatch(options);
+        }
+        else if (options.diff) {
+            succeeded = diffBuilds(paths[0], paths[1], paths[2]);
+        }
+        else if (options.apply) {
+            succeeded = applyPatch(paths[0], paths[1], paths[2]);
+        }
+        else if (!options.pakLayoutTrace.empty() && paths.size() == 2) {
+            // an existing pak laid out again, no conversion
+            succeeded = relayoutPak(paths[0], paths[1], options.pakLayoutTrace.c_str());
+        }
+        else if (paths.size() == 2) {
+            succeeded = processSingle(options, paths[0], paths[1]);
+        }
+        if (!options.timingsPath.empty()) {
+            detachTimingLog();
+        }
+        // every worker has joined by now, their buffers are complete
+        if (!options.tracePath.empty()) {
+            writeTrace(options.tracePath.c_str());
+        }
+    }
+
+    // stdout may carry the converted container, a daemon or watcher has no console to hold open
+    if (options.daemonSocket.empty() && !options.watch && (paths.size() < 2 || !isStandardStream(paths[1]))) {
+        system("pause");
+    }
+    return succeeded ? 0 : 1;
+}
+
+bool parseOptions(int argc, char** argv, ProcessOptions& options, std::vector<char const*>& paths)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string const arg{ argv[i] };
+        if (arg == "--vat") {
+            options.bakeVertexAnimation = true;
+        }
+        else if (arg.compare(0, 6, "--vat=") == 0) {
+            options.bakeVertexAnimation = true;
+            options.vertexAnimationFrameRate = std::strtof(arg.c_str() + 6, nullptr);
+            if (options.vertexAnimationFrameRate <= 0.0f) {
+                std::cerr << "Invalid frame rate in " << arg << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--bounds") {
+            options.computeAnimatedBounds = true;
+        }
+        else if (arg == "--bounds=segments") {
+            options.computeAnimatedBounds = true;
+            options.animatedBoundsSegments = true;
+        }
+        else if (arg == "--skeleton") {
+            options.flattenSkeleton = true;
+        }
+        else if (arg == "--trs") {
+            options.decomposeTransforms = true;
+        }
+        else if (arg == "--no-mmap") {
+            options.memoryMappedIO = false;
+        }
+        else if (arg.compare(0, 10, "--archive=") == 0) {
+            options.archivePath = arg.substr(10);
+        }
+        else if (arg.compare(0, 8, "--batch=") == 0) {
+            options.batchList = arg.substr(8);
+        }
+        else if (arg.compare(0, 9, "--format=") == 0) {
+            options.formatHint = arg.substr(9);
+        }
+        else if (arg.compare(0, 9, "--daemon=") == 0) {
+            options.daemonSocket = arg.substr(9);
+        }
+        else if (arg.compare(0, 8, "--cache=") == 0) {
+            options.cacheDirectory = arg.substr(8);
+        }
+        else if (arg.compare(0, 13, "--cache-size=") == 0) {
+            // in MiB
+            unsigned long long const size = std::strtoull(arg.c_str() + 13, nullptr, 10);
+            if (size == 0) {
+                std::cerr << "Invalid cache size in " << arg << std::endl;
+                return false;
+            }
+            options.cacheMaxBytes = static_cast<std::uint64_t>(size) << 20;
+        }
+        else if (arg == "--watch") {
+            options.watch = true;
+        }
+        else if (arg.compare(0, 7, "--deps=") == 0) {
+            options.dependencyDatabase = arg.substr(7);
+        }
+        else if (arg.compare(0, 10, "--timings=") == 0) {
+            options.timingsPath = arg.substr(10);
+        }
+        else if (arg.compare(0, 8, "--trace=") == 0) {
+            options.tracePath = arg.substr(8);
+        }
+        else if (arg == "--pipeline") {
+            options.pipelined = true;
+        }
+        else if (arg.compare(0, 11, "--pipeline=") == 0) {
+            // queue depths: imported assets waiting to be built, built ones waiting to be written
+            options.pipelined = true;
+            char* end = nullptr;
+            options.buildQueueDepth = std::strtoul(arg.c_str() + 11, &end, 10);
+            options.writeQueueDepth = *end == ',' ? std::strtoul(end + 1, &end, 10) : 0;
+            if (options.buildQueueDepth == 0 || options.writeQueueDepth == 0 || *end != '\0') {
+                std::cerr << "Invalid queue depths in " << arg << ", expected --pipeline=<build>,<write>" << std::endl;
+                return false;
+            }
+        }
+        else if (arg.compare(0, 9, "--writer=") == 0) {
+            if (!parseWriterKind(arg.substr(9), options.writer)) {
+                std::cerr << "Unknown writer in " << arg << ", expected stream, pwrite or uring" << std::endl;
+                return false;
+            }
+        }
+        else if (arg.compare(0, 6, "--pak=") == 0) {
+            options.pakPath = arg.substr(6);
+        }
+        else if (arg == "--pak-dedup") {
+            options.pakChunked = true;
+        }
+        else if (arg.compare(0, 13, "--pak-layout=") == 0) {
+            options.pakLayoutTrace = arg.substr(13);
+        }
+        else if (arg == "--diff") {
+            // <old> <new> <patch>
+            options.diff = true;
+        }
+        else if (arg == "--apply") {
+            // <old> <patch> <new>
+            options.apply = true;
+        }
+        else if (arg == "--direct") {
+            options.directIO = true;
+        }
+        else if (arg == "--max-memory") {
+            options.releaseSceneData = true;
+        }
+        else if (arg.compare(0, 10, "--targets=") == 0) {
+            if (!parseTargetProfiles(arg.substr(10), options.targets)) {
+                std::cerr << "Invalid target list in " << arg << std::endl;
+                return false;
+            }
+        }
+        else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+        else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (!options.pakPath.empty() && (options.batchList.empty() || options.watch || !options.daemonSocket.empty() || !options.dependencyDatabase.empty())) {
+        // a pak is rebuilt whole, skipping up-to-date assets would leave them out
+        std::cerr << "--pak needs --batch and can't be combined with --watch, --daemon or --deps" << std::endl;
+        return false;
+    }
+    if (!options.pakPath.empty() && (options.writer != WriterKind::Stream || options.directIO)) {
+        // the pak is the only output, nothing would go through the chosen writer
+        std::cerr << "--pak can't be combined with --writer or --direct" << std::endl;
+        return false;
+    }
+    if ((options.diff || options.apply) && paths.size() != 3) {
+        std::cerr << "--diff expects <old> <new> <patch>, --apply expects <old> <patch> <new>" << std::endl;
+        return false;
+    }
+    // the inputs stay mapped while the output is written
+    if ((options.diff || options.apply) && (std::string{ paths[2] } == paths[0] || std::string{ paths[2] } == paths[1])) {
+        std::cerr << "--diff and --apply can't write over one of their inputs" << std::endl;
+        return false;
+    }
+    // the source pak stays mapped while the new one is written
+    if (!options.pakLayoutTrace.empty() && options.batchList.empty() && paths.size() == 2 && std::string{ paths[0] } == paths[1]) {
+        std::cerr << "--pak-layout can't lay a pak out over itself" << std::endl;
+        return false;
+    }
+    if (options.pakChunked && options.pakPath.empty()) {
+        std::cerr << "--pak-dedup needs --pak" << std::endl;
+        return false;
+    }
+    if (options.releaseSceneData && !options.targets.empty()) {
+        // every target post-processes its own copy of the whole scene
+        std::cerr << "--max-memory can't be combined with --targets" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Batch list: one job per line, source and destination separated by a tab
+// (or by whitespace when the line has no tab).
+bool readBatchList(std::string const& listName, std::vector<std::pair<std::string, std::string>>& jobs)
+{
+    std::ifstream list{ listName };
+    if (!list) {
+        std::cerr << "Can't read the batch list " << listName << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(list, line)) {
+        std::string source;
+        std::string dest;
+        std::size_t const tab = line.find('\t');
+        if (tab != std::string::npos) {
+            source = line.substr(0, tab);
+            dest = line.substr(tab + 1);
+        }
+        else {
+            std::istringstream{ line } >> source >> dest;
+        }
+        if (!source.empty() && !dest.empty()) {
+            jobs.emplace_back(source, dest);
+        }
+    }
+    return true;
+}
+
+bool processSingle(ProcessOptions const& options, char const* sourceName, char const* destName)
+{
+    ProcessContext context;
+    if (!loadArchive(options, context)) {
+        return false;
+    }
+    context.importers = createImporterPool(options);
+    context.outputCache = createOutputCache(options);
+    context.dependencies = loadDependencies(options);
+    context.timings = createTimingSink(options);
+    context.writer = createOutputWriter(options.writer, options.directIO);
+    bool succeeded = processModel(sourceName, destName, options, context);
+    if (context.dependencies) {
+        succeeded = context.dependencies->Save() && succeeded;
+    }
+    return succeeded;
+}
+
+// False when any asset, the pak or the dependency database failed.
+bool processBatch(ProcessOptions const& options)
+{
+    std::vector<std::pair<std::string, std::string>> jobs;
+    if (!readBatchList(options.batchList, jobs)) {
+        return false;
+    }
+
+    // directory listings only describe the disk, archives answer from their own index
+    ProcessContext context;
+    if (!loadArchive(options, context)) {
+        return false;
+    }
+    context.ioCache = std::make_shared<IOCache>(options.archivePath.empty());
+    context.importers = createImporterPool(options);
+    context.outputCache = createOutputCache(options);
+    context.dependencies = loadDependencies(options);
+    context.timings = createTimingSink(options);
+    context.writer = createOutputWriter(options.writer, options.directIO);
+    std::shared_ptr<PakWriter> pak;
+    // with a layout trace the batch is packed aside first, then laid out into the pak
+    std::string const unorderedPak = options.pakLayoutTrace.empty() ? options.pakPath : options.pakPath + ".unordered";
+    if (!options.pakPath.empty()) {
+        // destination names become the paths inside the pak
+        pak = PakWriter::Create(unorderedPak.c_str(), options.pakChunked);
+        if (!pak) {
+            return false;
+        }
+        context.writer = pak;
+    }
+
+    std::atomic<bool> succeeded{ true };
+    if (options.pipelined) {
+        succeeded = processPipeline(jobs, options, context);
+    }
+    else {
+        parallelFor(jobs.size(), [&](std::size_t i) {
+            if (!processModel(jobs[i].first.c_str(), jobs[i].second.c_str(), options, context)) {
+                succeeded = false;
+            }
+        });
+    }
+
+    if (pak) {
+        if (!pak->Finish()) {
+            succeeded = false;
+        }
+        else if (!options.pakLayoutTrace.empty()) {
+            if (relayoutPak(unorderedPak.c_str(), options.pakPath.c_str(), options.pakLayoutTrace.c_str())) {
+                std::remove(unorderedPak.c_str());
+            }
+            else {
+                succeeded = false;
+            }
+        }
+    }
+
+    IOCacheStats const stats = context.ioCache->Stats();
+    std::cout << "Processed " << jobs.size() << " files" << std::endl
+        << "IO cache: exists " << stats.existsHits << " hits / " << stats.existsMisses << " misses, "
+        << "directory listings " << stats.listingHits << " hits / " << stats.listingMisses << " misses, "
+        << stats.openSkips << " opens of missing files skipped" << std::endl;
+    if (context.outputCache) {
+        printOutputCacheStats(*context.outputCache);
+    }
+    if (pak) {
+        printPakStats(*pak);
+    }
+    if (context.dependencies) {
+        printDependencyStats(*context.dependencies);
+        if (!context.dependencies->Save()) {
+            succeeded = false;
+        }
+    }
+    return succeeded;
+}
+
+// Converts the batch list (or the single source and destination) once, then reconverts
+// the assets whose recorded inputs change until interrupted. False when watching failed
+// or an asset's last conversion did.
+bool processWatch(ProcessOptions const& options, std::vector<char const*> const& paths)
+{
+    std::vector<std::pair<std::string, std::string>> jobs;
+    if (!options.batchList.empty()) {
+        if (!readBatchList(options.batchList, jobs)) {
+            return false;
+        }
+    }
+    else if (paths.size() == 2) {
+        jobs.emplace_back(paths[0], paths[1]);
+    }
+    if (jobs.empty() || !options.archivePath.empty()) {
+        std::cerr << "Watch mode needs source files on disk, from --batch or a source and destination" << std::endl;
+        return false;
+    }
+
+    // no IO cache, watched files change; without --deps the graph lives in memory only
+    ProcessContext context;
+    context.importers = createImporterPool(options);
+    context.outputCache = createOutputCache(options);
+    context.dependencies = std::make_shared<DependencyDatabase>(options.dependencyDatabase);
+    context.timings = createTimingSink(options);
+    context.writer = createOutputWriter(options.writer, options.directIO);
+
+    // skips everything the database already knows to be up to date; a job only ever
+    // rebuilds on one thread at a time, so its entry needs no lock
+    std::vector<char> failed(jobs.size(), 0);
+    parallelFor(jobs.size(), [&](std::size_t i) {
+        failed[i] = !processModel(jobs[i].first.c_str(), jobs[i].second.c_str(), options, context);
+    });
+    context.dependencies->Save();
+
+    auto inputsOf = [&](std::size_t job) {
+        std::vector<std::string> inputs = context.dependencies->Inputs(jobs[job].second);
+        // a source that failed to convert has no record but must still be watched
+        inputs.push_back(jobs[job].first);
+        return inputs;
+    };
+    auto rebuild = [&](std::size_t job) {
+        failed[job] = !processModel(jobs[job].first.c_str(), jobs[job].second.c_str(), options, context);
+        context.dependencies->Save();
+    };
+    std::size_t const workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+    bool const watched = runWatch(jobs.size(), inputsOf, rebuild, workerCount);
+    return watched && std::find(failed.begin(), failed.end(), 1) == failed.end() && context.dependencies->Save();
+}
+
+// False when the daemon couldn't serve, failed requests are only reported to their client.
+bool processDaemon(ProcessOptions const& options)
+{
+    if (!options.targets.empty()) {
+        std::cerr << "Targets are not supported in daemon mode, a request replies with one container" << std::endl;
+        return false;
+    }
+
+    // no IO cache here, files on disk may change between requests
+    ProcessContext context;
+    if (!loadArchive(options, context)) {
+        return false;
+    }
+    context.importers = createImporterPool(options);
+    context.outputCache = createOutputCache(options);
+    context.timings = createTimingSink(options);
+    context.writer = createOutputWriter(options.writer, options.directIO);
+
+    std::size_t const workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    return runDaemon(options.daemonSocket.c_str(), workerCount, [&](std::string const& sourceName, std::vector<std::uint8_t>& container) {
+        ScopedAsset asset{ context.timings.get(), sourceName.c_str(), "" };
+        std::vector<std::vector<Section>> outputs;
+        std::map<std::string, FileStamp> inputs;
+        if (!convertModel(sourceName.c_str(), options, context, outputs, inputs)) {
+            return false;
+        }
+        container = buildContainer(outputs[0]);
+        return true;
+    }, *context.writer);
+}
+
+std::shared_ptr<ImporterPool> createImporterPool(ProcessOptions const& options)
+{
+    bool const needsAnimations = options.bakeVertexAnimation || options.computeAnimatedBounds;
 
-    if (argc == 2) {
-        //meshes = processModel(*(argv + 1));
+    // only geometry, the hierarchy and (when asked for) animations are ever read
+    ImporterProperties properties;
+    properties.integers[AI_CONFIG_FAVOUR_SPEED] = 1;
+    properties.integers[AI_CONFIG_IMPORT_FBX_READ_MATERIALS] = 0;
+    properties.integers[AI_CONFIG_IMPORT_FBX_READ_ALL_MATERIALS] = 0;
+    properties.integers[AI_CONFIG_IMPORT_FBX_READ_CAMERAS] = 0;
+    properties.integers[AI_CONFIG_IMPORT_FBX_READ_LIGHTS] = 0;
+    properties.integers[AI_CONFIG_IMPORT_FBX_READ_ANIMATIONS] = needsAnimations ? 1 : 0;
+    return std::make_shared<ImporterPool>(std::move(properties));
+}
+
+std::shared_ptr<OutputCache> createOutputCache(ProcessOptions const& options)
+{
+    if (options.cacheDirectory.empty()) {
+        return nullptr;
+    }
+    return std::make_shared<OutputCache>(options.cacheDirectory, options.cacheMaxBytes);
+}
+
+// False when --archive names a bundle that can't be read, nothing can be converted then.
+bool loadArchive(ProcessOptions const& options, ProcessContext& context)
+{
+    if (options.archivePath.empty()) {
+        return true;
+    }
+    // stamped first, the dependency database then never holds a newer stamp than was read
+    if (!fileStamp(options.archivePath.c_str(), context.archiveStamp)) {
+        std::cerr << "ARCHIVE::ERROR" << std::endl
+            << "Can't read the archive " << options.archivePath << std::endl;
+        return false;
+    }
+    context.archive = Archive::Load(options.archivePath.c_str());
+    return context.archive != nullptr;
+}
+
+std::shared_ptr<DependencyDatabase> loadDependencies(ProcessOptions const& options)
+{
+    if (options.dependencyDatabase.empty()) {
+        return nullptr;
+    }
+    return std::make_shared<DependencyDatabase>(options.dependencyDatabase);
+}
+
+std::shared_ptr<TimingSink> createTimingSink(ProcessOptions const& options)
+{
+    if (options.timingsPath.empty()) {
+        return nullptr;
+    }
+    auto sink = std::make_shared<TimingSink>(options.timingsPath);
+    if (!sink->IsOpen()) {
+        std::cerr << "TIMING::ERROR" << std::endl
+            << "Can't open " << options.timingsPath << std::endl;
+        return nullptr;
+    }
+    // heap peaks are only worth their cost on every allocation when someone reads them
+    enableAllocationAccounting();
+    return sink;
+}
+
+// Everything but the inputs themselves that decides what an output contains.
+std::uint64_t outputFingerprint(ProcessOptions const& options, ImporterProperties const& properties)
+{
+    ContentHash key;
+    key.UpdateValue(TOOL_VERSION);
+    key.UpdateValue(aiGetVersionMajor());
+    key.UpdateValue(aiGetVersionMinor());
+    key.UpdateValue(aiGetVersionRevision());
+    key.UpdateValue(IMPORT_FLAGS);
+    key.UpdateValue(properties.Fingerprint());
+
+    key.UpdateValue(options.bakeVertexAnimation);
+    key.UpdateValue(options.vertexAnimationFrameRate);
+    key.UpdateValue(options.computeAnimatedBounds);
+    key.UpdateValue(options.animatedBoundsSegments);
+    key.UpdateValue(options.flattenSkeleton);
+    key.UpdateValue(options.decomposeTransforms);
+    // the hint picks the loader, so it can change what a source parses into
+    key.Update(options.formatHint.c_str(), options.formatHint.size() + 1);
+    for (TargetProfile const& target : options.targets) {
+        key.Update(target.name.c_str(), target.name.size() + 1);
+        key.UpdateValue(target.postProcessFlags);
+    }
+    return key.Digest();
+}
+
+std::uint64_t outputCacheKey(std::uint64_t sourceHash, std::uint64_t fingerprint)
+{
+    ContentHash key;
+    key.UpdateValue(sourceHash);
+    key.UpdateValue(fingerprint);
+    return key.Digest();
+}
+
+void printOutputCacheStats(OutputCache const& cache)
+{
+    OutputCacheStats const stats = cache.Stats();
+    std::uint64_t const lookups = stats.hits + stats.misses;
+    std::cout << "Output cache: " << stats.hits << " hits / " << stats.misses << " misses ("
+        << (lookups > 0 ? 100.0 * stats.hits / lookups : 0.0) << "% hit rate), "
+        << stats.stores << " stored, " << stats.evictions << " evicted" << std::endl;
+}
+
+void printDependencyStats(DependencyDatabase const& dependencies)
+{
+    DependencyStats const stats = dependencies.Stats();
+    std::cout << "Dependencies: " << stats.upToDate << " up to date, " << stats.rebuilt << " rebuilt" << std::endl;
+}
+
+void printPakStats(PakWriter const& pak)
+{
+    PakStats const stats = pak.Stats();
+    std::cout << "Pak: " << stats.assets << " assets, " << stats.storedBytes << " of " << stats.assetBytes << " bytes stored";
+    if (stats.chunks > 0) {
+        std::cout << " (" << (stats.assetBytes > 0 ? 100.0 * (stats.assetBytes - stats.storedBytes) / stats.assetBytes : 0.0)
+            << "% deduplicated), " << stats.chunks << " chunks for " << stats.chunkRefs << " references, "
+            << stats.scatteredAssets << " assets scattered";
     }
-    
-    system("pause");
-    return 0;
+    std::cout << std::endl;
 }
 
 Mesh processMesh(aiMesh* mesh, const aiScene* scene)
 {
     int const vertexCount = mesh->mNumVertices;
-    std::vector<Pos> vertices(vertexCount);
+    std::vector<Pos> vertices;
+    vertices.reserve(vertexCount);
     for (int i = 0; i < vertexCount; i++) {
         Pos vert;
 
@@ -66,29 +698,569 @@ Mesh processMesh(aiMesh* mesh, const aiScene* scene)
         }
     }
 
+    std::vector<MorphTarget> morphTargets;
+    for (unsigned int i = 0; i < mesh->mNumAnimMeshes; i++) {
+        morphTargets.emplace_back(processMorphTarget(mesh, mesh->mAnimMeshes[i]));
+    }
+
     Mesh processedMesh;
     processedMesh.vertices = std::move(vertices);
     processedMesh.indicies = std::move(indicies);
+    processedMesh.morphTargets = std::move(morphTargets);
     //processedMesh.material = mesh->mMaterialIndex;
 
     return processedMesh;
 }
 
-void processModel(char const* sourceName, char const* destName) {
-    Assimp::Importer importer;
-    aiScene const* scene = importer.ReadFile(std::string{ sourceName }, aiProcess_Triangulate | aiProcess_ConvertToLeftHanded);
-    if (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) {
+std::int16_t quantizeDelta(float delta, float scale)
+{
+    if (scale <= 0.0f) {
+        return 0;
+    }
+    return static_cast<std::int16_t>(std::lround(delta / scale));
+}
+
+MorphTarget processMorphTarget(aiMesh const* mesh, aiAnimMesh const* animMesh)
+{
+    bool const hasPositions = mesh->HasPositions() && animMesh->HasPositions();
+    bool const hasNormals = mesh->HasNormals() && animMesh->HasNormals();
+    unsigned int const vertexCount = std::min(mesh->mNumVertices, animMesh->mNumVertices);
+
+    // first pass finds the largest delta so the whole target shares one quantization scale
+    float maxPosition = 0.0f;
+    float maxNormal = 0.0f;
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        if (hasPositions) {
+            aiVector3D const delta = animMesh->mVertices[i] - mesh->mVertices[i];
+            maxPosition = std::max({ maxPosition, std::abs(delta.x), std::abs(delta.y), std::abs(delta.z) });
+        }
+        if (hasNormals) {
+            aiVector3D const delta = animMesh->mNormals[i] - mesh->mNormals[i];
+            maxNormal = std::max({ maxNormal, std::abs(delta.x), std::abs(delta.y), std::abs(delta.z) });
+        }
+    }
+
+    MorphTarget target;
+    target.positionScale = maxPosition / 32767.0f;
+    target.normalScale = maxNormal / 32767.0f;
+
+    // second pass keeps only vertices whose quantized delta is non-zero
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        std::int16_t position[3] = { 0, 0, 0 };
+        std::int16_t normal[3] = { 0, 0, 0 };
+        if (hasPositions) {
+            aiVector3D const delta = animMesh->mVertices[i] - mesh->mVertices[i];
+            position[0] = quantizeDelta(delta.x, target.positionScale);
+            position[1] = quantizeDelta(delta.y, target.positionScale);
+            position[2] = quantizeDelta(delta.z, target.positionScale);
+        }
+        if (hasNormals) {
+            aiVector3D const delta = animMesh->mNormals[i] - mesh->mNormals[i];
+            normal[0] = quantizeDelta(delta.x, target.normalScale);
+            normal[1] = quantizeDelta(delta.y, target.normalScale);
+            normal[2] = quantizeDelta(delta.z, target.normalScale);
+        }
+
+        bool const moves =
+            position[0] != 0 || position[1] != 0 || position[2] != 0 ||
+            normal[0] != 0 || normal[1] != 0 || normal[2] != 0;
+        if (moves) {
+            target.indicies.push_back(i);
+            target.positionDeltas.insert(target.positionDeltas.end(), position, position + 3);
+            target.normalDeltas.insert(target.normalDeltas.end(), normal, normal + 3);
+        }
+    }
+
+    return target;
+}
+
+bool processModel(char const* sourceName, char const* destName, ProcessOptions const& options, ProcessContext& context) {
+    ScopedAsset asset{ context.timings.get(), sourceName, destName };
+    ModelJob job;
+    job.sourceName = sourceName;
+    job.destName = destName;
+    if (!startModel(job, options, context)) {
+        return job.upToDate;
+    }
+    if (!importModel(job, options, context)) {
+        return false;
+    }
+    buildOutputs(job, options);
+    return finishModel(job, context);
+}
+
+// Import, build and write run as stages on their own threads joined by bounded queues, so the
+// next assets parse and finished ones are written while the current ones are being built.
+// False when any asset failed.
+bool processPipeline(std::vector<std::pair<std::string, std::string>> const& jobs, ProcessOptions const& options, ProcessContext& context)
+{
+    BoundedQueue<std::unique_ptr<ModelJob>> imported{ options.buildQueueDepth };
+    BoundedQueue<std::unique_ptr<ModelJob>> built{ options.writeQueueDepth };
+
+    // parsing and building are both CPU bound, writing gets its own thread
+    std::size_t const hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t const importThreads = std::max<std::size_t>(hardwareThreads / 2, 1);
+    std::size_t const buildThreads = std::max<std::size_t>(hardwareThreads - importThreads, 1);
+
+    std::atomic<bool> succeeded{ true };
+    std::atomic<std::size_t> next{ 0 };
+    std::atomic<std::size_t> importing{ importThreads };
+    auto importStage = [&]() {
+        traceThreadName("import");
+        ParallelWorkerScope worker;
+        for (std::size_t i = next++; i < jobs.size(); i = next++) {
+            auto job = std::make_unique<ModelJob>();
+            job->sourceName = jobs[i].first;
+            job->destName = jobs[i].second;
+            // a job dropped here still writes its record, when it's destroyed
+            job->asset = std::make_unique<AssetRecord>(context.timings.get(), job->sourceName.c_str(), job->destName.c_str());
+            {
+                CurrentAsset asset{ *job->asset };
+                if (!startModel(*job, options, context)) {
+                    if (!job->upToDate) {
+                        succeeded = false;
+                    }
+                    continue;
+                }
+                if (!importModel(*job, options, context)) {
+                    succeeded = false;
+                    continue;
+                }
+            }
+            imported.Push(std::move(job));
+        }
+        if (--importing == 0) {
+            imported.Close();
+        }
+    };
+    auto buildStage = [&]() {
+        traceThreadName("build");
+        ParallelWorkerScope worker;
+        std::unique_ptr<ModelJob> job;
+        while (imported.Pop(job)) {
+            {
+                CurrentAsset asset{ *job->asset };
+                buildOutputs(*job, options);
+            }
+            built.Push(std::move(job));
+        }
+    };
+    auto writeStage = [&]() {
+        traceThreadName("write");
+        std::unique_ptr<ModelJob> job;
+        while (built.Pop(job)) {
+            {
+                CurrentAsset asset{ *job->asset };
+                if (!finishModel(*job, context)) {
+                    succeeded = false;
+                }
+            }
+            job->asset->Finish();
+        }
+    };
+
+    std::vector<std::thread> producers;
+    for (std::size_t i = 0; i < importThreads; i++) {
+        producers.emplace_back(importStage);
+    }
+    for (std::size_t i = 0; i < buildThreads; i++) {
+        producers.emplace_back(buildStage);
+    }
+    std::thread writer{ writeStage };
+    // the builders return once the importers closed their queue and it ran dry
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    built.Close();
+    writer.join();
+    return succeeded;
+}
+
+// Output names and the dependency check, false when there is nothing to convert.
+bool startModel(ModelJob& job, ProcessOptions const& options, ProcessContext& context)
+{
+    char const* sourceName = job.sourceName.c_str();
+    char const* destName = job.destName.c_str();
+    if (!options.targets.empty() && isStandardStream(destName)) {
+        std::cerr << "Targets need a destination file name, not stdout" << std::endl;
+        return false;
+    }
+    if (options.targets.empty()) {
+        job.destNames.push_back(job.destName);
+    }
+    for (TargetProfile const& target : options.targets) {
+        job.destNames.push_back(targetDestName(destName, target.name));
+    }
+
+    // piped sources and outputs have nothing on disk to compare against
+    job.tracked = context.dependencies && !isStandardStream(sourceName) && !isStandardStream(destName);
+    if (job.tracked) {
+        ScopedStage stage{ "dependency check" };
+        job.fingerprint = outputFingerprint(options, context.importers->Properties());
+        if (context.dependencies->UpToDate(job.destName, job.sourceName, job.fingerprint, job.destNames)) {
+            job.upToDate = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Cache store, the containers themselves and the dependency record. False when an output
+// couldn't be written.
+bool finishModel(ModelJob& job, ProcessContext& context)
+{
+    storeOutputs(job, context);
+    bool written = true;
+    for (std::size_t i = 0; i < job.outputs.size(); i++) {
+        ScopedStage stage{ "write" };
+        written = context.writer->Write(job.destNames[i].c_str(), buildContainer(job.outputs[i])) && written;
+    }
+    if (job.tracked && written) {
+        ScopedStage stage{ "dependency record" };
+        if (job.stamped) {
+            context.dependencies->Record(job.destName, job.sourceName, job.fingerprint, job.inputs);
+        }
+        else {
+            // an input that can't be stamped can't be checked, leave the output unrecorded
+            context.dependencies->Forget(job.destName);
+        }
+    }
+    return written;
+}
+
+// Paths inside an archive can't be stamped on disk, the archive itself stands in for them.
+// False when an input, or the source itself, has no stamp.
+bool recordInputs(ProcessOptions const& options, ProcessContext const& context, char const* sourceName,
+    std::map<std::string, TrackedFile> const& opened, std::map<std::string, FileStamp>& inputs)
+{
+    if (context.archive) {
+        inputs[options.archivePath] = context.archiveStamp;
+        return true;
+    }
+    if (opened.find(sourceName) == opened.end()) {
+        return false;
+    }
+    for (auto const& file : opened) {
+        if (!file.second.stamped) {
+            return false;
+        }
+        inputs[file.first] = file.second.stamp;
+    }
+    return true;
+}
+
+// One output per target profile, or a single one without targets.
+// inputs receives every file the outputs were built from.
+bool convertModel(char const* sourceName, ProcessOptions const& options, ProcessContext& context,
+    std::vector<std::vector<Section>>& outputs, std::map<std::string, FileStamp>& inputs) {
+    ModelJob job;
+    job.sourceName = sourceName;
+    if (!importModel(job, options, context)) {
+        return false;
+    }
+    buildOutputs(job, options);
+    storeOutputs(job, context);
+    outputs = std::move(job.outputs);
+    inputs = std::move(job.inputs);
+    return true;
+}
+
+// Answers from the output cache or imports the source. Without targets the scene is left in
+// job.scene for buildOutputs, targets post-process their copies of it here on the importer.
+bool importModel(ModelJob& job, ProcessOptions const& options, ProcessContext& context)
+{
+    char const* sourceName = job.sourceName.c_str();
+    PooledImporter importer{ *context.importers };
+    // the wrappers below need a concrete IOSystem to decorate, so assimp's default one is
+    // never used; stdio stands in for it with mapped IO turned off
+    Assimp::IOSystem* ioSystem;
+    if (context.archive) {
+        // the source name is then a path inside the archive
+        ioSystem = new ArchiveIOSystem{ context.archive };
+    }
+    else if (options.memoryMappedIO) {
+        ioSystem = new MappedIOSystem;
+    }
+    else {
+        ioSystem = new FileIOSystem;
+    }
+    if (context.ioCache) {
+        ioSystem = new CachingIOSystem{ ioSystem, context.ioCache };
+    }
+
+    // the cache and the dependency database need every file the import reads
+    TrackingIOSystem* tracker = nullptr;
+    bool const cached = context.outputCache && !isStandardStream(sourceName);
+    if ((cached || context.dependencies) && !isStandardStream(sourceName)) {
+        tracker = new TrackingIOSystem{ ioSystem };
+        ioSystem = tracker;
+    }
+    // a pooled importer may still hold the previous job's handler
+    installIOHandler(*importer, ioSystem);
+
+    // kept out of the pool properties, timing a run must not change its cache keys
+    bool const timed = context.timings != nullptr;
+    importer->SetPropertyBool(AI_CONFIG_GLOB_MEASURE_TIME, timed);
+    installProgressHandler(*importer, timed ? new TimingProgressHandler : nullptr);
+
+    if (cached) {
+        ScopedStage stage{ "cache lookup" };
+        std::uint64_t sourceHash;
+        // read through the tracker, a hit's inputs are stamped before they are hashed
+        if (hashFile(*tracker, sourceName, sourceHash)) {
+            job.cacheKey = outputCacheKey(sourceHash, outputFingerprint(options, context.importers->Properties()));
+            std::vector<std::string> sidePaths;
+            if (context.outputCache->Lookup(job.cacheKey, sourceName, *tracker, job.outputs, sidePaths)) {
+                job.stamped = recordInputs(options, context, sourceName, tracker->OpenedFiles(), job.inputs);
+                return true;
+            }
+            job.keyed = true;
+        }
+    }
+    if (tracker) {
+        // a missed entry's side files may not be this import's, and a stored one needs their hashes
+        tracker->Restart(job.keyed);
+    }
+
+    unsigned int const flags = IMPORT_FLAGS;
+    aiScene const* scene = nullptr;
+    if (isStandardStream(sourceName)) {
+        // piped sources are read whole and parsed from memory, side files can't be resolved
+        std::vector<std::uint8_t> buffer;
+        if (!readStandardInput(buffer)) {
+            std::cerr << "Can't read stdin" << std::endl;
+            return false;
+        }
+        ScopedStage stage{ "import" };
+        scene = importer->ReadFileFromMemory(buffer.data(), buffer.size(), flags, options.formatHint.c_str());
+    }
+    else {
+        ScopedStage stage{ "import" };
+        scene = importer->ReadFile(std::string{ sourceName }, flags);
+    }
+    if (!scene || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE)) {
         std::cerr << "ASSIMP::IMPORTER::ERROR" << std::endl
             << "Can't read the file " << sourceName << std::endl;
+        return false;
+    }
+    if (recordingAsset()) {
+        // walks the whole scene, only worth it when someone reads the numbers
+        aiMemoryInfo memory;
+        importer->GetMemoryRequirements(memory);
+        recordSceneMemory(memory);
+    }
+
+    if (options.targets.empty()) {
+        // owned from here on, so any thread can build it and free it piece by piece
+        job.scene.reset(importer->GetOrphanedScene());
     }
     else {
-        std::vector<Mesh> storage;
-        recursiveMeshParse(scene->mRootNode, scene, storage);
+        // every target post-processes its own copy of this single parse
+        job.outputs.resize(options.targets.size());
+        bool const processed = processTargets(*importer, options.targets, [&](std::size_t target, aiScene const* targetScene) {
+            buildSections(targetScene, options, job.outputs[target]);
+        });
+        if (!processed) {
+            return false;
+        }
+    }
+
+    if (tracker) {
+        job.stamped = recordInputs(options, context, sourceName, tracker->OpenedFiles(), job.inputs);
+    }
+    if (job.keyed) {
+        job.keyed = collectSideFiles(sourceName, tracker->OpenedFiles(), tracker->Inner(), job.sideFiles);
+    }
+    return true;
+}
+
+void buildOutputs(ModelJob& job, ProcessOptions const& options)
+{
+    if (!job.scene) {
+        return;
+    }
+    job.outputs.resize(1);
+    buildSections(job.scene.get(), options, job.outputs[0], options.releaseSceneData ? job.scene.get() : nullptr);
+    job.scene.reset();
+}
+
+void storeOutputs(ModelJob& job, ProcessContext& context)
+{
+    if (job.keyed) {
+        ScopedStage stage{ "cache store" };
+        context.outputCache->Store(job.cacheKey, job.sideFiles, job.outputs);
     }
 }
 
-void recursiveMeshParse(aiNode const* mesh, aiScene const* scene, std::vector<Mesh>& storage) {
+// Scene-wide sections first, then every mesh's sections in node order. With a releasable scene
+// (the scene itself, owned by the caller) each aiMesh is freed once its last reference is
+// serialized and the animations once every mesh is done, so the scene shrinks as the output grows.
+void buildSections(aiScene const* scene, ProcessOptions const& options, std::vector<Section>& sections, aiScene* releasable)
+{
+    if (releasable) {
+        releaseUnusedSceneData(releasable);
+    }
+
+    std::vector<unsigned int> meshes;
+    recursiveMeshCollect(scene->mRootNode, meshes);
+    // an instanced mesh is referenced from several nodes
+    std::vector<std::size_t> lastReference(scene->mNumMeshes, 0);
+    for (std::size_t i = 0; i < meshes.size(); i++) {
+        lastReference[meshes[i]] = i;
+    }
+
+    bool const animated = options.bakeVertexAnimation || options.computeAnimatedBounds || options.flattenSkeleton || options.decomposeTransforms;
+    NodeHierarchy hierarchy;
+    std::vector<std::int32_t> jointByNode;
+    if (animated) {
+        {
+            ScopedStage stage{ "hierarchy" };
+            hierarchy = flattenHierarchy(scene->mRootNode);
+        }
+
+        if (options.decomposeTransforms) {
+            ScopedStage stage{ "transforms" };
+            Section transforms{ SectionType::NodeTransforms, NO_MESH, {} };
+            serializeNodeTransforms(decomposeTransforms(hierarchy), transforms.data);
+            sections.emplace_back(std::move(transforms));
+        }
+
+        // reads the bones of every mesh, so it runs before any mesh is released
+        if (options.flattenSkeleton) {
+            ScopedStage stage{ "skeleton" };
+            Section skeleton{ SectionType::Skeleton, NO_MESH, {} };
+            serializeSkeleton(buildSkeleton(scene, hierarchy, jointByNode), skeleton.data);
+            sections.emplace_back(std::move(skeleton));
+        }
+    }
+
+    for (std::size_t i = 0; i < meshes.size(); i++) {
+        aiMesh const* source = scene->mMeshes[meshes[i]];
+        Mesh mesh;
+        {
+            ScopedStage stage{ "extract meshes" };
+            mesh = processMesh(scene->mMeshes[meshes[i]], scene);
+            mesh.sourceMesh = meshes[i];
+        }
+
+        if (animated && source->HasBones()) {
+            if (options.bakeVertexAnimation) {
+                ScopedStage stage{ "vertex animation" };
+                for (unsigned int j = 0; j < scene->mNumAnimations; j++) {
+                    mesh.vertexAnimations.emplace_back(bakeVertexAnimation(scene, hierarchy, source, j, options.vertexAnimationFrameRate));
+                }
+            }
+            if (options.computeAnimatedBounds) {
+                ScopedStage stage{ "animated bounds" };
+                mesh.animatedBounds = computeAnimatedBounds(scene, hierarchy, source, options.animatedBoundsSegments);
+            }
+            if (options.flattenSkeleton) {
+                ScopedStage stage{ "joint remap" };
+                remapJoints(source, hierarchy, jointByNode, mesh.jointRemap);
+            }
+        }
+
+        {
+            ScopedStage stage{ "serialize" };
+            appendMeshSections(mesh, static_cast<std::uint32_t>(i), sections);
+        }
+
+        if (releasable && lastReference[meshes[i]] == i) {
+            ScopedStage stage{ "release" };
+            delete releasable->mMeshes[meshes[i]];
+            releasable->mMeshes[meshes[i]] = nullptr;
+        }
+    }
 
+    if (releasable) {
+        releaseAnimations(releasable);
+    }
+}
+
+void appendMeshSections(Mesh const& mesh, std::uint32_t meshIndex, std::vector<Section>& sections)
+{
+    Section positions{ SectionType::Positions, meshIndex, {} };
+    serializeMeshPositions(mesh, positions.data);
+    sections.emplace_back(std::move(positions));
+
+    Section indicies{ SectionType::Indicies, meshIndex, {} };
+    serializeMeshIndicies(mesh, indicies.data);
+    sections.emplace_back(std::move(indicies));
+
+    if (!mesh.morphTargets.empty()) {
+        Section morphTargets{ SectionType::MorphTargets, meshIndex, {} };
+        serializeMeshMorphTargets(mesh, morphTargets.data);
+        sections.emplace_back(std::move(morphTargets));
+    }
+
+    for (VertexAnimation const& animation : mesh.vertexAnimations) {
+        Section vertexAnimation{ SectionType::VertexAnimation, meshIndex, {} };
+        serializeVertexAnimation(animation, vertexAnimation.data);
+        sections.emplace_back(std::move(vertexAnimation));
+    }
+
+    for (AnimatedBounds const& bounds : mesh.animatedBounds) {
+        Section animatedBounds{ SectionType::AnimatedBounds, meshIndex, {} };
+        serializeAnimatedBounds(bounds, animatedBounds.data);
+        sections.emplace_back(std::move(animatedBounds));
+    }
+
+    if (!mesh.jointRemap.empty()) {
+        Section jointRemap{ SectionType::JointRemap, meshIndex, {} };
+        appendBytes(jointRemap.data, mesh.jointRemap.data(), mesh.jointRemap.size());
+        sections.emplace_back(std::move(jointRemap));
+    }
+}
+
+// Embedded textures, materials, cameras and lights are never read.
+void releaseUnusedSceneData(aiScene* scene)
+{
+    for (unsigned int i = 0; i < scene->mNumTextures; i++) {
+        delete scene->mTextures[i];
+    }
+    delete[] scene->mTextures;
+    scene->mTextures = nullptr;
+    scene->mNumTextures = 0;
+
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+        delete scene->mMaterials[i];
+    }
+    delete[] scene->mMaterials;
+    scene->mMaterials = nullptr;
+    scene->mNumMaterials = 0;
+
+    for (unsigned int i = 0; i < scene->mNumCameras; i++) {
+        delete scene->mCameras[i];
+    }
+    delete[] scene->mCameras;
+    scene->mCameras = nullptr;
+    scene->mNumCameras = 0;
+
+    for (unsigned int i = 0; i < scene->mNumLights; i++) {
+        delete scene->mLights[i];
+    }
+    delete[] scene->mLights;
+    scene->mLights = nullptr;
+    scene->mNumLights = 0;
+}
+
+void releaseAnimations(aiScene* scene)
+{
+    for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+        delete scene->mAnimations[i];
+    }
+    delete[] scene->mAnimations;
+    scene->mAnimations = nullptr;
+    scene->mNumAnimations = 0;
+}
+
+void recursiveMeshCollect(aiNode const* node, std::vector<unsigned int>& meshes) {
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        meshes.push_back(node->mMeshes[i]);
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        recursiveMeshCollect(node->mChildren[i], meshes);
+    }
 }
 
 void serializeMeshPositions(Mesh const& mesh, std::vector<std::uint8_t>& storage)
@@ -99,6 +1271,7 @@ void serializeMeshPositions(Mesh const& mesh, std::vector<std::uint8_t>& storage
         position[0] = mesh.vertices[i].x;
         position[1] = mesh.vertices[i].y;
         position[2] = mesh.vertices[i].z;
+        std::memcpy(buffer, position, sizeof(position));
 
         for (std::size_t j = 0; j < sizeof(position); j++) {
             storage.emplace_back(buffer[j]);
@@ -112,9 +1285,75 @@ void serializeMeshIndicies(Mesh const& mesh, std::vector<std::uint8_t>& storage)
     std::uint8_t buffer[sizeof(index)];
     for (std::size_t i = 0; i < mesh.indicies.size(); i++) {
         index = mesh.indicies[i];
+        std::memcpy(buffer, &index, sizeof(index));
 
         for (std::size_t j = 0; j < sizeof(index); j++) {
             storage.emplace_back(buffer[j]);
         }
     }
+}
+
+void serializeMeshMorphTargets(Mesh const& mesh, std::vector<std::uint8_t>& storage)
+{
+    appendValue(storage, static_cast<std::uint32_t>(mesh.morphTargets.size()));
+    for (MorphTarget const& target : mesh.morphTargets) {
+        appendValue(storage, static_cast<std::uint32_t>(target.indicies.size()));
+        appendValue(storage, target.positionScale);
+        appendValue(storage, target.normalScale);
+        appendBytes(storage, target.indicies.data(), target.indicies.size());
+        appendBytes(storage, target.positionDeltas.data(), target.positionDeltas.size());
+        appendBytes(storage, target.normalDeltas.data(), target.normalDeltas.size());
+    }
+}
+
+void serializeVertexAnimation(VertexAnimation const& animation, std::vector<std::uint8_t>& storage)
+{
+    appendValue(storage, animation.animation);
+    appendValue(storage, animation.frameCount);
+    appendValue(storage, animation.vertexCount);
+    appendValue(storage, animation.frameRate);
+    appendBytes(storage, animation.boundsMin, 3);
+    appendBytes(storage, animation.boundsMax, 3);
+    appendBytes(storage, animation.positions.data(), animation.positions.size());
+    appendBytes(storage, animation.normals.data(), animation.normals.size());
+}
+
+void serializeAnimatedBounds(AnimatedBounds const& bounds, std::vector<std::uint8_t>& storage)
+{
+    appendValue(storage, bounds.animation);
+    appendValue(storage, bounds.clip);
+    appendValue(storage, static_cast<std::uint32_t>(bounds.segments.size()));
+    appendBytes(storage, bounds.segmentTimes.data(), bounds.segmentTimes.size());
+    appendBytes(storage, bounds.segments.data(), bounds.segments.size());
+}
+
+void serializeSkeleton(Skeleton const& skeleton, std::vector<std::uint8_t>& storage)
+{
+    appendValue(storage, static_cast<std::uint32_t>(skeleton.parents.size()));
+    appendBytes(storage, skeleton.nameHashes.data(), skeleton.nameHashes.size());
+    appendBytes(storage, skeleton.parents.data(), skeleton.parents.size());
+    appendBytes(storage, skeleton.localBindTransforms.data(), skeleton.localBindTransforms.size());
+    appendBytes(storage, skeleton.inverseBindMatrices.data(), skeleton.inverseBindMatrices.size());
+}
+
+void serializeNodeTransforms(NodeTransforms const& transforms, std::vector<std::uint8_t>& storage)
+{
+    std::size_t const nodeCount = transforms.parents.size();
+    appendValue(storage, static_cast<std::uint32_t>(nodeCount));
+    appendValue(storage, static_cast<std::uint32_t>(transforms.nonUniformScales.size() / 3));
+    appendValue(storage, static_cast<std::uint32_t>(transforms.fallbackMatrices.size()));
+    appendBytes(storage, transforms.nameHashes.data(), nodeCount);
+    appendBytes(storage, transforms.parents.data(), nodeCount);
+    appendBytes(storage, transforms.flags.data(), nodeCount);
+    storage.resize((storage.size() + 3) / 4 * 4, 0);
+    appendBytes(storage, transforms.translationX.data(), nodeCount);
+    appendBytes(storage, transforms.translationY.data(), nodeCount);
+    appendBytes(storage, transforms.translationZ.data(), nodeCount);
+    appendBytes(storage, transforms.scales.data(), nodeCount);
+    appendBytes(storage, transforms.rotationA.data(), nodeCount);
+    appendBytes(storage, transforms.rotationB.data(), nodeCount);
+    appendBytes(storage, transforms.rotationC.data(), nodeCount);
+    storage.resize((storage.size() + 3) / 4 * 4, 0);
+    appendBytes(storage, transforms.nonUniformScales.data(), transforms.nonUniformScales.size());
+    appendBytes(storage, transforms.fallbackMatrices.data(), transforms.fallbackMatrices.size());
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <malloc.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <sys/resource.h>
+#else
+#include <malloc.h>
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+
+// trivially initialized, usable from the very first allocation of a thread
+thread_local std::int64_t liveBytes = 0;
+thread_local std::int64_t peakBytes = 0;
+thread_local std::uint64_t allocationCount = 0;
+
+// constant initialized, so it is valid before any static constructor allocates
+std::atomic<bool> accounting{ false };
+
+// An alignment of 0 is malloc's own.
+void* allocateBlock(std::size_t size, std::size_t alignment) noexcept
+{
+    size = size ? size : 1;
+    if (alignment == 0) {
+        return std::malloc(size);
+    }
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* pointer = nullptr;
+    return posix_memalign(&pointer, std::max(alignment, sizeof(void*)), size) == 0 ? pointer : nullptr;
+#endif
+}
+
+void freeBlock(void* pointer, std::size_t alignment) noexcept
+{
+#ifdef _WIN32
+    if (alignment != 0) {
+        _aligned_free(pointer);
+        return;
+    }
+#endif
+    static_cast<void>(alignment);
+    std::free(pointer);
+}
+
+std::size_t allocatedSize(void* pointer, std::size_t alignment)
+{
+    // the allocator's own bookkeeping, no header of ours on every block
+#ifdef _WIN32
+    return alignment != 0 ? _aligned_msize(pointer, alignment, 0) : _msize(pointer);
+#elif defined(__APPLE__)
+    static_cast<void>(alignment);
+    return malloc_size(pointer);
+#else
+    static_cast<void>(alignment);
+    return malloc_usable_size(pointer);
+#endif
+}
+
+void* countedAllocate(std::size_t size, std::size_t alignment = 0) noexcept
+{
+    void* pointer = allocateBlock(size, alignment);
+    if (pointer && accounting.load(std::memory_order_relaxed)) {
+        liveBytes += static_cast<std::int64_t>(allocatedSize(pointer, alignment));
+        peakBytes = std::max(peakBytes, liveBytes);
+        allocationCount++;
+    }
+    return pointer;
+}
+
+void* countedAllocateOrThrow(std::size_t size, std::size_t alignment = 0)
+{
+    for (;;) {
+        if (void* pointer = countedAllocate(size, alignment)) {
+            return pointer;
+        }
+        std::new_handler const handler = std::get_new_handler();
+        if (!handler) {
+            throw std::bad_alloc{};
+        }
+        handler();
+    }
+}
+
+void countedFree(void* pointer, std::size_t alignment = 0) noexcept
+{
+    if (pointer) {
+        if (accounting.load(std::memory_order_relaxed)) {
+            // a block freed by another thread than its allocator lowers that thread's count instead
+            liveBytes -= static_cast<std::int64_t>(allocatedSize(pointer, alignment));
+        }
+        freeBlock(pointer, alignment);
+    }
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+    return countedAllocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return countedAllocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, std::nothrow_t const&) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::nothrow_t const&) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    countedFree(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    countedFree(pointer);
+}
+
+#ifdef __cpp_aligned_new
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return countedAllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    return countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    return countedAllocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer, std::align_val_t alignment) noexcept
+{
+    countedFree(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept
+{
+    countedFree(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    countedFree(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment, std::nothrow_t const&) noexcept
+{
+    countedFree(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+    countedFree(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+    countedFree(pointer, static_cast<std::size_t>(alignment));
+}
+
+#endif
+
+void enableAllocationAccounting()
+{
+    accounting.store(true, std::memory_order_relaxed);
+}
+
+AllocationScope::AllocationScope()
+    : baseline_{ liveBytes }
+    , outerPeak_{ peakBytes }
+    , allocations_{ allocationCount }
+{
+    peakBytes = liveBytes;
+}
+
+AllocationScope::~AllocationScope()
+{
+    // an enclosing scope still sees the highest point reached inside this one
+    peakBytes = std::max(peakBytes, outerPeak_);
+}
+
+std::int64_t AllocationScope::PeakBytes() const
+{
+    return std::max<std::int64_t>(peakBytes - baseline_, 0);
+}
+
+std::uint64_t AllocationScope::Allocations() const
+{
+    return allocationCount - allocations_;
+}
+
+std::uint64_t peakResidentBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+    // kilobytes on Linux
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Turns on the counting in the global operator new and delete replaced in memory.cpp,
+// which otherwise only forward to the allocator. Call it before any worker starts.
+void enableAllocationAccounting();
+
+// Heap use of the calling thread while the scope is alive, 0 unless accounting is on.
+// Allocations made by a statically linked assimp are included, a DLL build uses its own
+// heap and is not. Blocks are charged to the thread that frees them: a scene built on one
+// worker and freed on another raises the first thread's peak and lowers the second's
+// live count, so per-stage peaks are exact only for memory freed where it was allocated.
+class AllocationScope
+{
+public:
+    AllocationScope();
+    AllocationScope(AllocationScope const&) = delete;
+    AllocationScope& operator=(AllocationScope const&) = delete;
+    ~AllocationScope();
+
+    // Highest live heap bytes above what the thread held when the scope began.
+    std::int64_t PeakBytes() const;
+    std::uint64_t Allocations() const;
+
+private:
+    std::int64_t baseline_;
+    std::int64_t outerPeak_;
+    std::uint64_t allocations_;
+};
+
+// High-water mark of the whole process' resident set, 0 where unknown.
+std::uint64_t peakResidentBytes();
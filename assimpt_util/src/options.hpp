@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "targets.hpp"
+#include "writer.hpp"
+
+// Bump whenever a change alters the containers produced from the same input,
+// cached outputs of older versions are then ignored.
+std::uint32_t const TOOL_VERSION = 1;
+
+struct ProcessOptions
+{
+    bool bakeVertexAnimation = false;
+    float vertexAnimationFrameRate = 30.0f;
+    bool computeAnimatedBounds = false;
+    bool animatedBoundsSegments = false;
+    bool flattenSkeleton = false;
+    bool decomposeTransforms = false;
+    bool memoryMappedIO = true;
+    std::string archivePath;
+    std::string batchList;
+    std::string formatHint;
+    std::string daemonSocket;
+    std::vector<TargetProfile> targets;
+    std::string cacheDirectory;
+    std::uint64_t cacheMaxBytes = 4ull << 30;
+    std::string dependencyDatabase;
+    bool watch = false;
+    std::string timingsPath;
+    std::string tracePath;
+    bool releaseSceneData = false;
+    bool pipelined = false;
+    std::size_t buildQueueDepth = 4;
+    std::size_t writeQueueDepth = 8;
+    WriterKind writer = WriterKind::Stream;
+    bool directIO = false;
+    std::string pakPath;
+    bool pakChunked = false;
+    std::string pakLayoutTrace;
+    bool diff = false;
+    bool apply = false;
+};
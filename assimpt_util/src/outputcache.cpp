@@ -0,0 +1,351 @@
+#include "outputcache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include "hash.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#endif
+
+namespace
+{
+
+std::uint32_t const CACHE_MAGIC = 0x45435541; // "AUCE"
+std::uint32_t const CACHE_VERSION = 1;
+char const* const ENTRY_EXTENSION = ".entry";
+
+struct CacheEntryHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t sideFileCount;
+    std::uint32_t outputCount;
+};
+
+struct SideFileRecord
+{
+    std::uint32_t relative;
+    std::uint32_t pathLength;
+    std::uint64_t hash;
+};
+
+// Bounds-checked reads from a loaded entry file.
+class EntryReader
+{
+public:
+    explicit EntryReader(std::vector<std::uint8_t> const& bytes) : bytes_{ bytes }, position_{ 0 } { }
+
+    bool Read(void* data, std::size_t size)
+    {
+        if (size > bytes_.size() - position_) {
+            return false;
+        }
+        std::memcpy(data, bytes_.data() + position_, size);
+        position_ += size;
+        return true;
+    }
+
+    std::uint8_t const* Take(std::size_t size)
+    {
+        if (size > bytes_.size() - position_) {
+            return nullptr;
+        }
+        std::uint8_t const* data = bytes_.data() + position_;
+        position_ += size;
+        return data;
+    }
+
+private:
+    std::vector<std::uint8_t> const& bytes_;
+    std::size_t position_;
+};
+
+std::string sourceDirectory(std::string const& sourceName)
+{
+    std::size_t const separator = sourceName.find_last_of("/\\");
+    return separator == std::string::npos ? std::string{} : sourceName.substr(0, separator + 1);
+}
+
+std::string keyName(std::uint64_t key)
+{
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return name;
+}
+
+bool parseKeyName(std::string const& fileName, std::uint64_t& key)
+{
+    std::size_t const extensionLength = std::strlen(ENTRY_EXTENSION);
+    if (fileName.size() != 16 + extensionLength || fileName.compare(16, extensionLength, ENTRY_EXTENSION) != 0) {
+        return false;
+    }
+    key = 0;
+    for (std::size_t i = 0; i < 16; i++) {
+        char const c = fileName[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        }
+        else {
+            return false;
+        }
+        key = (key << 4) | static_cast<std::uint64_t>(digit);
+    }
+    return true;
+}
+
+bool readWholeFile(std::string const& path, std::vector<std::uint8_t>& bytes)
+{
+    std::ifstream file{ path, std::ios::binary | std::ios::ate };
+    if (!file) {
+        return false;
+    }
+    std::streamoff const size = file.tellg();
+    if (size < 0) {
+        return false;
+    }
+    bytes.resize(static_cast<std::size_t>(size));
+    file.seekg(0);
+    return static_cast<bool>(file.read(reinterpret_cast<char*>(bytes.data()), size));
+}
+
+void createDirectory(std::string const& directory)
+{
+#ifdef _WIN32
+    CreateDirectoryA(directory.c_str(), nullptr);
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+}
+
+void touchFile(std::string const& path)
+{
+#ifdef _WIN32
+    _utime(path.c_str(), nullptr);
+#else
+    utime(path.c_str(), nullptr);
+#endif
+}
+
+}
+
+OutputCache::OutputCache(std::string directory, std::uint64_t maxBytes)
+    : directory_{ std::move(directory) }
+    , maxBytes_{ maxBytes }
+{
+    createDirectory(directory_);
+
+    // entry files carry their own last use as their modification time
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE const find = FindFirstFileA((directory_ + "\\*" + ENTRY_EXTENSION).c_str(), &found);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            std::uint64_t key;
+            if (parseKeyName(found.cFileName, key)) {
+                std::uint64_t const size = (static_cast<std::uint64_t>(found.nFileSizeHigh) << 32) | found.nFileSizeLow;
+                std::uint64_t const ticks = (static_cast<std::uint64_t>(found.ftLastWriteTime.dwHighDateTime) << 32) | found.ftLastWriteTime.dwLowDateTime;
+                // FILETIME counts 100ns ticks since 1601
+                std::time_t const lastUse = static_cast<std::time_t>((ticks - 116444736000000000ull) / 10000000ull);
+                entries_[key] = Entry{ size, lastUse };
+                totalBytes_ += size;
+            }
+        } while (FindNextFileA(find, &found));
+        FindClose(find);
+    }
+#else
+    if (DIR* const dir = opendir(directory_.c_str())) {
+        while (dirent const* found = readdir(dir)) {
+            std::uint64_t key;
+            struct stat status;
+            if (parseKeyName(found->d_name, key) && stat(EntryPath(key).c_str(), &status) == 0) {
+                entries_[key] = Entry{ static_cast<std::uint64_t>(status.st_size), status.st_mtime };
+                totalBytes_ += static_cast<std::uint64_t>(status.st_size);
+            }
+        }
+        closedir(dir);
+    }
+#endif
+}
+
+bool OutputCache::Lookup(std::uint64_t key, std::string const& sourceName, Assimp::IOSystem& io,
+    std::vector<std::vector<Section>>& outputs, std::vector<std::string>& sidePaths)
+{
+    std::vector<std::uint8_t> bytes;
+    if (!readWholeFile(EntryPath(key), bytes)) {
+        misses_++;
+        return false;
+    }
+
+    EntryReader reader{ bytes };
+    CacheEntryHeader header;
+    if (!reader.Read(&header, sizeof(header)) || header.magic != CACHE_MAGIC || header.version != CACHE_VERSION) {
+        misses_++;
+        return false;
+    }
+
+    std::string const directory = sourceDirectory(sourceName);
+    std::vector<std::string> verified;
+    for (std::uint32_t i = 0; i < header.sideFileCount; i++) {
+        SideFileRecord record;
+        std::uint8_t const* path = nullptr;
+        if (!reader.Read(&record, sizeof(record)) || !(path = reader.Take(record.pathLength))) {
+            misses_++;
+            return false;
+        }
+        std::string const sidePath = (record.relative ? directory : std::string{}) + std::string{ path, path + record.pathLength };
+        std::uint64_t hash;
+        if (!hashFile(io, sidePath.c_str(), hash) || hash != record.hash) {
+            misses_++;
+            return false;
+        }
+        verified.push_back(sidePath);
+    }
+
+    std::vector<std::vector<Section>> cached(header.outputCount);
+    for (std::vector<Section>& sections : cached) {
+        std::uint64_t size;
+        std::uint8_t const* container = nullptr;
+        if (!reader.Read(&size, sizeof(size)) || !(container = reader.Take(static_cast<std::size_t>(size))) ||
+            !parseContainer(container, static_cast<std::size_t>(size), sections)) {
+            misses_++;
+            return false;
+        }
+    }
+
+    outputs = std::move(cached);
+    sidePaths = std::move(verified);
+    hits_++;
+    touchFile(EntryPath(key));
+    Touch(key, bytes.size());
+    return true;
+}
+
+void OutputCache::Store(std::uint64_t key, std::vector<CachedSideFile> const& sideFiles, std::vector<std::vector<Section>> const& outputs)
+{
+    CacheEntryHeader header;
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.sideFileCount = static_cast<std::uint32_t>(sideFiles.size());
+    header.outputCount = static_cast<std::uint32_t>(outputs.size());
+
+    std::vector<std::uint8_t> bytes;
+    appendValue(bytes, header);
+    for (CachedSideFile const& sideFile : sideFiles) {
+        SideFileRecord const record{ sideFile.relative ? 1u : 0u, static_cast<std::uint32_t>(sideFile.path.size()), sideFile.hash };
+        appendValue(bytes, record);
+        appendBytes(bytes, sideFile.path.data(), sideFile.path.size());
+    }
+    for (std::vector<Section> const& sections : outputs) {
+        std::vector<std::uint8_t> const container = buildContainer(sections);
+        appendValue(bytes, static_cast<std::uint64_t>(container.size()));
+        appendBytes(bytes, container.data(), container.size());
+    }
+
+    // written aside and renamed into place, readers never see a partial entry
+    std::string temporary;
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        temporary = EntryPath(key) + ".tmp" + std::to_string(nextTemporary_++);
+    }
+    {
+        std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+        file.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+        if (!file) {
+            file.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    if (!replaceFile(temporary, EntryPath(key))) {
+        std::remove(temporary.c_str());
+        return;
+    }
+    stores_++;
+    Touch(key, bytes.size());
+}
+
+OutputCacheStats OutputCache::Stats() const
+{
+    return OutputCacheStats{ hits_, misses_, stores_, evictions_ };
+}
+
+std::string OutputCache::EntryPath(std::uint64_t key) const
+{
+    return directory_ + "/" + keyName(key) + ENTRY_EXTENSION;
+}
+
+void OutputCache::Touch(std::uint64_t key, std::uint64_t size)
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    auto const found = entries_.find(key);
+    if (found != entries_.end()) {
+        totalBytes_ -= found->second.size;
+    }
+    entries_[key] = Entry{ size, std::time(nullptr) };
+    totalBytes_ += size;
+    Trim();
+}
+
+void OutputCache::Trim()
+{
+    if (totalBytes_ <= maxBytes_) {
+        return;
+    }
+
+    // trims to 90% of the cap so a full cache doesn't sort its index on every store
+    std::vector<std::pair<std::time_t, std::uint64_t>> byAge;
+    byAge.reserve(entries_.size());
+    for (auto const& entry : entries_) {
+        byAge.emplace_back(entry.second.lastUse, entry.first);
+    }
+    std::sort(byAge.begin(), byAge.end());
+
+    std::uint64_t const target = maxBytes_ / 10 * 9;
+    for (auto const& entry : byAge) {
+        if (totalBytes_ <= target) {
+            break;
+        }
+        std::remove(EntryPath(entry.second).c_str());
+        totalBytes_ -= entries_[entry.second].size;
+        entries_.erase(entry.second);
+        evictions_++;
+    }
+}
+
+bool collectSideFiles(std::string const& sourceName, std::map<std::string, TrackedFile> const& opened, Assimp::IOSystem& io,
+    std::vector<CachedSideFile>& sideFiles)
+{
+    std::string const directory = sourceDirectory(sourceName);
+    for (auto const& file : opened) {
+        std::string const& path = file.first;
+        if (io.ComparePaths(path.c_str(), sourceName.c_str())) {
+            continue;
+        }
+        if (!file.second.hashed) {
+            return false;
+        }
+        CachedSideFile sideFile;
+        sideFile.relative = path.compare(0, directory.size(), directory) == 0;
+        sideFile.path = sideFile.relative ? path.substr(directory.size()) : path;
+        sideFile.hash = file.second.hash;
+        sideFiles.push_back(std::move(sideFile));
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <assimp\IOStream.hpp>
+#include <assimp\IOSystem.hpp>
+
+#include "container.hpp"
+#include "io.hpp"
+
+struct OutputCacheStats
+{
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t stores;
+    std::uint64_t evictions;
+};
+
+// A side file an output was built from. Paths under the source's directory are kept
+// relative to it, so a moved or renamed asset folder still hits.
+struct CachedSideFile
+{
+    bool relative;
+    std::string path;
+    std::uint64_t hash;
+};
+
+// On-disk cache of converted outputs, one <key>.entry file per key.
+// The key covers the source content, every option that shapes the output and the tool
+// version; side files are only known after an import, so each entry lists them with
+// their content hash and a lookup re-hashes them before it counts as a hit.
+// Least recently used entries are evicted once the directory outgrows maxBytes.
+class OutputCache
+{
+public:
+    OutputCache(std::string directory, std::uint64_t maxBytes);
+
+    // On a hit sidePaths receives the verified side files, resolved against sourceName.
+    bool Lookup(std::uint64_t key, std::string const& sourceName, Assimp::IOSystem& io,
+        std::vector<std::vector<Section>>& outputs, std::vector<std::string>& sidePaths);
+    void Store(std::uint64_t key, std::vector<CachedSideFile> const& sideFiles, std::vector<std::vector<Section>> const& outputs);
+
+    OutputCacheStats Stats() const;
+
+private:
+    struct Entry
+    {
+        std::uint64_t size;
+        std::time_t lastUse;
+    };
+
+    std::string EntryPath(std::uint64_t key) const;
+    void Touch(std::uint64_t key, std::uint64_t size);
+    // Called with mutex_ held.
+    void Trim();
+
+    std::string const directory_;
+    std::uint64_t const maxBytes_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::uint64_t, Entry> entries_;
+    std::uint64_t totalBytes_ = 0;
+    std::uint64_t nextTemporary_ = 0;
+
+    std::atomic<std::uint64_t> hits_{ 0 };
+    std::atomic<std::uint64_t> misses_{ 0 };
+    std::atomic<std::uint64_t> stores_{ 0 };
+    std::atomic<std::uint64_t> evictions_{ 0 };
+};
+
+// The files an import opened besides the source itself with the hashes taken as they were
+// opened, false when one couldn't be hashed.
+bool collectSideFiles(std::string const& sourceName, std::map<std::string, TrackedFile> const& opened, Assimp::IOSystem& io,
+    std::vector<CachedSideFile>& sideFiles);
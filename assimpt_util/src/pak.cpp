@@ -0,0 +1,684 @@
+#include "pak.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+
+#include "container.hpp"
+#include "hash.hpp"
+
+namespace
+{
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+std::uint32_t bucketOf(std::uint64_t pathHash, std::uint32_t bucketBits)
+{
+    return bucketBits == 0 ? 0 : static_cast<std::uint32_t>(pathHash >> (64 - bucketBits));
+}
+
+std::string normalizePath(char const* path, std::size_t length)
+{
+    std::string normalized{ path, length };
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+    return normalized;
+}
+
+// Chunks average about 8 KiB past the minimum, small enough to share a vertex stream between
+// assets and large enough to keep the chunk table a fraction of a percent of the data.
+std::size_t const CHUNK_MIN_SIZE = 2 * 1024;
+std::size_t const CHUNK_MAX_SIZE = 64 * 1024;
+std::uint64_t const CHUNK_MASK = ~std::uint64_t{ 0 } << (64 - 13);
+
+// Random values for the gear hash, from splitmix64 so every build cuts at the same places.
+std::uint64_t const* gearTable()
+{
+    static std::uint64_t const* const table = [] {
+        static std::uint64_t values[256];
+        std::uint64_t state = 0;
+        for (std::uint64_t& value : values) {
+            state += 0x9E3779B97F4A7C15ull;
+            std::uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+std::uint64_t chunkHash(std::uint8_t const* data, std::size_t size)
+{
+    ContentHash hash;
+    hash.Update(data, size);
+    hash.UpdateValue(static_cast<std::uint64_t>(size));
+    return hash.Digest();
+}
+
+}
+
+// Each byte shifts the gear hash left by one, so its top bits depend on the last 64 bytes
+// only and a cut lands on the same content wherever it sits in the asset.
+void pakContentBoundaries(std::uint8_t const* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& boundaries)
+{
+    std::uint64_t const* const gear = gearTable();
+    std::size_t start = begin;
+    std::uint64_t hash = 0;
+    for (std::size_t i = begin; i < end; i++) {
+        hash = (hash << 1) + gear[data[i]];
+        std::size_t const length = i + 1 - start;
+        if ((length >= CHUNK_MIN_SIZE && (hash & CHUNK_MASK) == 0) || length >= CHUNK_MAX_SIZE) {
+            boundaries.push_back(i + 1);
+            start = i + 1;
+            hash = 0;
+        }
+    }
+    if (start < end) {
+        boundaries.push_back(end);
+    }
+}
+
+std::vector<std::size_t> pakSectionBoundaries(std::uint8_t const* data, std::size_t size)
+{
+    std::vector<std::size_t> forced{ 0, size };
+    ContainerHeader header;
+    if (size >= sizeof(header)) {
+        std::memcpy(&header, data, sizeof(header));
+    }
+    if (size >= sizeof(header) && header.magic == CONTAINER_MAGIC &&
+        header.sectionCount <= (size - sizeof(header)) / sizeof(SectionEntry)) {
+        for (std::uint32_t i = 0; i < header.sectionCount; i++) {
+            SectionEntry entry;
+            std::memcpy(&entry, data + sizeof(header) + sizeof(SectionEntry) * i, sizeof(entry));
+            if (entry.offset <= size && entry.size <= size - entry.offset) {
+                forced.push_back(static_cast<std::size_t>(entry.offset));
+                forced.push_back(static_cast<std::size_t>(entry.offset + entry.size));
+            }
+        }
+    }
+    std::sort(forced.begin(), forced.end());
+    forced.erase(std::unique(forced.begin(), forced.end()), forced.end());
+    return forced;
+}
+
+std::vector<std::size_t> pakChunkBoundaries(std::uint8_t const* data, std::size_t size)
+{
+    std::vector<std::size_t> const forced = pakSectionBoundaries(data, size);
+    std::vector<std::size_t> boundaries;
+    for (std::size_t i = 1; i < forced.size(); i++) {
+        pakContentBoundaries(data, forced[i - 1], forced[i], boundaries);
+    }
+    return boundaries;
+}
+
+std::uint64_t pakPathHash(char const* path, std::size_t length)
+{
+    std::string const normalized = normalizePath(path, length);
+    ContentHash hash;
+    hash.Update(normalized.data(), normalized.size());
+    return hash.Digest();
+}
+
+std::unique_ptr<PakWriter> PakWriter::Create(char const* path, bool chunked)
+{
+    std::unique_ptr<PakWriter> writer{ new PakWriter{ path, chunked } };
+    if (!writer->file_) {
+        std::cerr << "PAK::ERROR" << std::endl
+            << "Can't create the pak " << path << std::endl;
+        return nullptr;
+    }
+    return writer;
+}
+
+PakWriter::PakWriter(std::string path, bool chunked)
+    : path_{ std::move(path) }
+    , chunked_{ chunked }
+    , file_{ path_, std::ios::binary | std::ios::trunc }
+{
+    // the header is only known once every asset is in, Finish comes back for it
+    PakHeader header;
+    std::memset(&header, 0, sizeof(header));
+    file_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    offset_ = sizeof(header);
+}
+
+bool PakWriter::Write(char const* destName, std::vector<std::uint8_t> const& bytes)
+{
+    std::size_t const nameLength = std::strlen(destName);
+    Pending entry{ normalizePath(destName, nameLength), pakPathHash(destName, nameLength), 0, bytes.size(), {}, false };
+
+    if (!chunked_) {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        if (!Append(bytes.data(), bytes.size(), true, entry.offset)) {
+            std::cerr << "PAK::ERROR" << std::endl
+                << "Can't add " << destName << " to the pak " << path_ << std::endl;
+            return false;
+        }
+        assetBytes_ += bytes.size();
+        pending_.push_back(std::move(entry));
+        return true;
+    }
+
+    // cutting and hashing run on the calling worker, only the lookups are serialized
+    std::vector<std::size_t> const boundaries = pakChunkBoundaries(bytes.data(), bytes.size());
+    std::vector<std::uint64_t> hashes;
+    std::size_t start = 0;
+    for (std::size_t end : boundaries) {
+        hashes.push_back(chunkHash(bytes.data() + start, end - start));
+        start = end;
+    }
+
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    // only the asset's first new chunk is aligned, the rest follow it unpadded so an asset
+    // made of new chunks only is one piece
+    bool aligned = true;
+    start = 0;
+    for (std::size_t i = 0; i < boundaries.size(); i++) {
+        std::size_t const size = boundaries[i] - start;
+        auto found = chunkIndex_.find(hashes[i]);
+        if (found == chunkIndex_.end()) {
+            PakChunk chunk{ 0, static_cast<std::uint32_t>(size), 0 };
+            if (!Append(bytes.data() + start, size, aligned, chunk.offset)) {
+                std::cerr << "PAK::ERROR" << std::endl
+                    << "Can't add " << destName << " to the pak " << path_ << std::endl;
+                return false;
+            }
+            found = chunkIndex_.emplace(hashes[i], static_cast<std::uint32_t>(chunks_.size())).first;
+            chunks_.push_back(chunk);
+            aligned = false;
+        }
+        chunks_[found->second].refCount++;
+        if (!entry.chunks.empty()) {
+            PakChunk const& previous = chunks_[entry.chunks.back()];
+            entry.scattered = entry.scattered || chunks_[found->second].offset != previous.offset + previous.size;
+        }
+        entry.chunks.push_back(found->second);
+        start = boundaries[i];
+    }
+    if (!entry.chunks.empty()) {
+        entry.offset = chunks_[entry.chunks.front()].offset;
+    }
+    assetBytes_ += bytes.size();
+    pending_.push_back(std::move(entry));
+    return true;
+}
+
+bool PakWriter::Append(std::uint8_t const* data, std::size_t size, bool aligned, std::uint64_t& offset)
+{
+    std::uint64_t const start = aligned ? alignUp(offset_, PAK_ALIGNMENT) : offset_;
+    static char const padding[PAK_ALIGNMENT] = {};
+    file_.write(padding, static_cast<std::streamsize>(start - offset_));
+    file_.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(size));
+    if (!file_) {
+        return false;
+    }
+    offset = start;
+    offset_ = start + size;
+    storedBytes_ += size;
+    return true;
+}
+
+PakStats PakWriter::Stats() const
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    PakStats stats{ pending_.size(), assetBytes_, chunks_.size(), 0, storedBytes_, 0 };
+    for (Pending const& pending : pending_) {
+        stats.chunkRefs += pending.chunks.size();
+        stats.scatteredAssets += pending.scattered ? 1 : 0;
+    }
+    return stats;
+}
+
+bool PakWriter::Finish()
+{
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    std::sort(pending_.begin(), pending_.end(), [](Pending const& one, Pending const& other) {
+        return one.pathHash < other.pathHash || (one.pathHash == other.pathHash && one.name < other.name);
+    });
+    for (std::size_t i = 1; i < pending_.size(); i++) {
+        if (pending_[i].pathHash == pending_[i - 1].pathHash) {
+            // a second write of one path or, far less likely, two paths sharing a hash
+            std::cerr << "PAK::ERROR" << std::endl
+                << pending_[i - 1].name << " and " << pending_[i].name << " have the same path hash" << std::endl;
+            return false;
+        }
+    }
+
+    std::uint32_t bucketBits = 0;
+    while ((std::size_t{ 1 } << bucketBits) < pending_.size() && bucketBits < 24) {
+        bucketBits++;
+    }
+    std::vector<std::uint32_t> buckets((std::size_t{ 1 } << bucketBits) + 1, 0);
+    std::vector<PakEntry> entries;
+    std::vector<std::uint32_t> refs;
+    std::string names;
+    for (Pending const& pending : pending_) {
+        entries.push_back(PakEntry{ pending.pathHash, pending.offset, pending.size,
+            static_cast<std::uint32_t>(names.size()), static_cast<std::uint32_t>(pending.name.size()),
+            static_cast<std::uint32_t>(refs.size()), static_cast<std::uint32_t>(pending.chunks.size()) });
+        names += pending.name;
+        refs.insert(refs.end(), pending.chunks.begin(), pending.chunks.end());
+        buckets[bucketOf(pending.pathHash, bucketBits) + 1]++;
+    }
+    for (std::size_t i = 1; i < buckets.size(); i++) {
+        buckets[i] += buckets[i - 1];
+    }
+
+    PakHeader header;
+    header.magic = PAK_MAGIC;
+    header.version = PAK_VERSION;
+    header.entryCount = static_cast<std::uint32_t>(entries.size());
+    header.bucketBits = bucketBits;
+    header.indexOffset = alignUp(offset_, PAK_ALIGNMENT);
+    header.chunksOffset = header.indexOffset + sizeof(PakEntry) * entries.size();
+    header.bucketsOffset = header.chunksOffset + sizeof(PakChunk) * chunks_.size();
+    header.refsOffset = header.bucketsOffset + sizeof(std::uint32_t) * buckets.size();
+    header.namesOffset = header.refsOffset + sizeof(std::uint32_t) * refs.size();
+    header.namesSize = names.size();
+    header.chunkCount = static_cast<std::uint32_t>(chunks_.size());
+    header.refCount = static_cast<std::uint32_t>(refs.size());
+
+    static char const padding[PAK_ALIGNMENT] = {};
+    file_.write(padding, static_cast<std::streamsize>(header.indexOffset - offset_));
+    file_.write(reinterpret_cast<char const*>(entries.data()), static_cast<std::streamsize>(sizeof(PakEntry) * entries.size()));
+    file_.write(reinterpret_cast<char const*>(chunks_.data()), static_cast<std::streamsize>(sizeof(PakChunk) * chunks_.size()));
+    file_.write(reinterpret_cast<char const*>(buckets.data()), static_cast<std::streamsize>(sizeof(std::uint32_t) * buckets.size()));
+    file_.write(reinterpret_cast<char const*>(refs.data()), static_cast<std::streamsize>(sizeof(std::uint32_t) * refs.size()));
+    file_.write(names.data(), static_cast<std::streamsize>(names.size()));
+    file_.seekp(0);
+    file_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file_.close();
+    if (!file_) {
+        std::cerr << "PAK::ERROR" << std::endl
+            << "Can't write the index of the pak " << path_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<PakReader> PakReader::Open(char const* path)
+{
+    std::unique_ptr<PakReader> reader{ new PakReader };
+    reader->file_ = MappedFile::Open(path);
+    if (!reader->file_) {
+        std::cerr << "PAK::ERROR" << std::endl
+            << "Can't open the pak " << path << std::endl;
+        return nullptr;
+    }
+
+    std::uint8_t const* data = reader->file_->Data();
+    std::uint64_t const size = reader->file_->Size();
+    PakHeader& header = reader->header_;
+    bool valid = size >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, data, sizeof(header));
+        std::uint64_t const bucketCount = (std::uint64_t{ 1 } << std::min<std::uint32_t>(header.bucketBits, 32)) + 1;
+        valid = header.magic == PAK_MAGIC && header.version == PAK_VERSION && header.bucketBits <= 24 &&
+            header.indexOffset % alignof(PakEntry) == 0 &&
+            header.indexOffset <= size && header.entryCount <= (size - header.indexOffset) / sizeof(PakEntry) &&
+            header.chunksOffset == header.indexOffset + sizeof(PakEntry) * header.entryCount &&
+            header.chunkCount <= (size - header.chunksOffset) / sizeof(PakChunk) &&
+            header.bucketsOffset == header.chunksOffset + sizeof(PakChunk) * header.chunkCount &&
+            header.refsOffset == header.bucketsOffset + sizeof(std::uint32_t) * bucketCount &&
+            header.namesOffset == header.refsOffset + sizeof(std::uint32_t) * std::uint64_t{ header.refCount } &&
+            header.namesOffset <= size && header.namesSize <= size - header.namesOffset;
+    }
+    if (valid) {
+        reader->entries_ = reinterpret_cast<PakEntry const*>(data + header.indexOffset);
+        reader->chunks_ = reinterpret_cast<PakChunk const*>(data + header.chunksOffset);
+        reader->buckets_ = reinterpret_cast<std::uint32_t const*>(data + header.bucketsOffset);
+        reader->refs_ = reinterpret_cast<std::uint32_t const*>(data + header.refsOffset);
+        reader->names_ = reinterpret_cast<char const*>(data + header.namesOffset);
+        std::uint64_t const bucketCount = (std::uint64_t{ 1 } << header.bucketBits) + 1;
+        valid = reader->buckets_[bucketCount - 1] == header.entryCount;
+        for (std::uint64_t i = 1; valid && i < bucketCount; i++) {
+            valid = reader->buckets_[i - 1] <= reader->buckets_[i];
+        }
+        for (std::uint32_t i = 0; valid && i < header.chunkCount; i++) {
+            PakChunk const& chunk = reader->chunks_[i];
+            valid = chunk.offset <= size && chunk.size <= size - chunk.offset;
+        }
+        for (std::uint32_t i = 0; valid && i < header.refCount; i++) {
+            valid = reader->refs_[i] < header.chunkCount;
+        }
+        for (std::uint32_t i = 0; valid && i < header.entryCount; i++) {
+            PakEntry const& entry = reader->entries_[i];
+            valid = entry.nameOffset <= header.namesSize && entry.nameSize <= header.namesSize - entry.nameOffset &&
+                entry.firstRef <= header.refCount && entry.refCount <= header.refCount - entry.firstRef;
+            if (valid && entry.refCount == 0) {
+                valid = entry.offset <= size && entry.size <= size - entry.offset;
+            }
+            else if (valid) {
+                // the chunks have to add up to the asset
+                std::uint64_t total = 0;
+                for (std::uint32_t ref = entry.firstRef; ref < entry.firstRef + entry.refCount; ref++) {
+                    total += reader->chunks_[reader->refs_[ref]].size;
+                }
+                valid = total == entry.size;
+            }
+        }
+    }
+    if (!valid) {
+        std::cerr << "PAK::ERROR" << std::endl
+            << path << " is not a valid pak" << std::endl;
+        return nullptr;
+    }
+    return reader;
+}
+
+bool PakReader::Find(char const* path, std::uint8_t const*& data, std::size_t& size) const
+{
+    std::size_t index;
+    if (!FindEntry(path, index)) {
+        return false;
+    }
+    std::uint8_t const* found = EntryRange(index, 0, entries_[index].size);
+    if (!found) {
+        scatteredLookups_++;
+        return false;
+    }
+    RecordAccess(index, -1);
+    data = found;
+    size = static_cast<std::size_t>(entries_[index].size);
+    return true;
+}
+
+bool PakReader::FindSection(char const* path, std::size_t section, std::uint8_t const*& data, std::size_t& size) const
+{
+    std::size_t index;
+    std::uint64_t offset;
+    std::uint64_t sectionSize;
+    if (!FindEntry(path, index) || !SectionRange(index, section, offset, sectionSize)) {
+        return false;
+    }
+    std::uint8_t const* found = EntryRange(index, offset, sectionSize);
+    if (!found) {
+        scatteredLookups_++;
+        return false;
+    }
+    RecordAccess(index, static_cast<std::int64_t>(section));
+    data = found;
+    size = static_cast<std::size_t>(sectionSize);
+    return true;
+}
+
+bool PakReader::Read(char const* path, std::vector<std::uint8_t>& bytes) const
+{
+    std::size_t index;
+    if (!FindEntry(path, index) || !EntryBytes(index, bytes)) {
+        return false;
+    }
+    RecordAccess(index, -1);
+    return true;
+}
+
+bool PakReader::ReadSection(char const* path, std::size_t section, std::vector<std::uint8_t>& bytes) const
+{
+    std::size_t index;
+    std::uint64_t offset;
+    std::uint64_t size;
+    if (!FindEntry(path, index) || !SectionRange(index, section, offset, size)) {
+        return false;
+    }
+    bytes.resize(static_cast<std::size_t>(size));
+    if (!CopyRange(index, offset, size, bytes.data())) {
+        return false;
+    }
+    RecordAccess(index, static_cast<std::int64_t>(section));
+    return true;
+}
+
+bool PakReader::EntryBytes(std::size_t index, std::vector<std::uint8_t>& bytes) const
+{
+    bytes.resize(static_cast<std::size_t>(entries_[index].size));
+    return CopyRange(index, 0, entries_[index].size, bytes.data());
+}
+
+bool PakReader::SectionRange(std::size_t index, std::size_t section, std::uint64_t& offset, std::uint64_t& size) const
+{
+    std::uint64_t const containerSize = entries_[index].size;
+    ContainerHeader header;
+    if (containerSize < sizeof(header) || !CopyRange(index, 0, sizeof(header), reinterpret_cast<std::uint8_t*>(&header))) {
+        return false;
+    }
+    if (header.magic != CONTAINER_MAGIC || section >= header.sectionCount ||
+        sizeof(header) + sizeof(SectionEntry) * (section + 1) > containerSize) {
+        return false;
+    }
+    SectionEntry entry;
+    if (!CopyRange(index, sizeof(header) + sizeof(SectionEntry) * section, sizeof(entry), reinterpret_cast<std::uint8_t*>(&entry)) ||
+        entry.offset > containerSize || entry.size > containerSize - entry.offset) {
+        return false;
+    }
+    offset = entry.offset;
+    size = entry.size;
+    return true;
+}
+
+std::uint8_t const* PakReader::EntryRange(std::size_t index, std::uint64_t offset, std::uint64_t size) const
+{
+    PakEntry const& entry = entries_[index];
+    if (entry.refCount == 0) {
+        return file_->Data() + entry.offset + offset;
+    }
+    if (size == 0) {
+        return file_->Data();
+    }
+    // from the chunk holding the first byte, every next one must start where the last ended
+    std::uint8_t const* start = nullptr;
+    std::uint64_t end = 0;
+    std::uint64_t position = 0;
+    for (std::uint32_t ref = entry.firstRef; ref < entry.firstRef + entry.refCount; ref++) {
+        PakChunk const& chunk = chunks_[refs_[ref]];
+        if (!start && offset < position + chunk.size) {
+            start = file_->Data() + chunk.offset + (offset - position);
+        }
+        else if (start && chunk.offset != end) {
+            return nullptr;
+        }
+        end = chunk.offset + chunk.size;
+        position += chunk.size;
+        if (start && offset + size <= position) {
+            return start;
+        }
+    }
+    return nullptr;
+}
+
+bool PakReader::CopyRange(std::size_t index, std::uint64_t offset, std::uint64_t size, std::uint8_t* out) const
+{
+    PakEntry const& entry = entries_[index];
+    if (offset > entry.size || size > entry.size - offset) {
+        return false;
+    }
+    if (entry.refCount == 0) {
+        std::memcpy(out, file_->Data() + entry.offset + offset, static_cast<std::size_t>(size));
+        return true;
+    }
+    std::uint64_t position = 0;
+    for (std::uint32_t ref = entry.firstRef; ref < entry.firstRef + entry.refCount && size > 0; ref++) {
+        PakChunk const& chunk = chunks_[refs_[ref]];
+        if (offset < position + chunk.size) {
+            std::uint64_t const skip = offset - position;
+            std::uint64_t const count = std::min<std::uint64_t>(size, chunk.size - skip);
+            std::memcpy(out, file_->Data() + chunk.offset + skip, static_cast<std::size_t>(count));
+            out += count;
+            offset += count;
+            size -= count;
+        }
+        position += chunk.size;
+    }
+    return true;
+}
+
+bool PakReader::FindEntry(char const* path, std::size_t& index) const
+{
+    std::uint64_t const pathHash = pakPathHash(path, std::strlen(path));
+    std::uint32_t const bucket = bucketOf(pathHash, header_.bucketBits);
+    for (std::uint32_t i = buckets_[bucket]; i < buckets_[bucket + 1]; i++) {
+        if (entries_[i].pathHash == pathHash) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PakReader::StartAccessTrace()
+{
+    tracing_ = true;
+}
+
+void PakReader::RecordAccess(std::size_t index, std::int64_t section) const
+{
+    // lookups stay lock free unless a trace is being recorded
+    if (!tracing_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock{ traceMutex_ };
+    if (accessed_.emplace(index, section).second) {
+        accesses_.emplace_back(index, section);
+    }
+}
+
+// One access per line: the asset path, and a tab and the section index for a section.
+bool PakReader::WriteAccessTrace(char const* path) const
+{
+    std::ofstream file{ path, std::ios::trunc };
+    std::lock_guard<std::mutex> lock{ traceMutex_ };
+    for (auto const& access : accesses_) {
+        file << EntryName(access.first);
+        if (access.second >= 0) {
+            file << '\t' << access.second;
+        }
+        file << '\n';
+    }
+    if (!file) {
+        std::cerr << "PAK::ERROR" << std::endl
+            << "Can't write the access trace " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string PakReader::EntryName(std::size_t index) const
+{
+    return std::string{ names_ + entries_[index].nameOffset, entries_[index].nameSize };
+}
+
+bool relayoutPak(char const* sourcePath, char const* destPath, char const* tracePath)
+{
+    std::ifstream trace{ tracePath };
+    if (!trace) {
+        std::cerr << "PAK::ERROR" << std::endl
+            << "Can't read the access trace " << tracePath << std::endl;
+        return false;
+    }
+    std::unique_ptr<PakReader> reader = PakReader::Open(sourcePath);
+    if (!reader) {
+        return false;
+    }
+
+    std::size_t const entryCount = reader->EntryCount();
+    std::unordered_map<std::string, std::size_t> indexByName;
+    for (std::size_t i = 0; i < entryCount; i++) {
+        indexByName[reader->EntryName(i)] = i;
+    }
+
+    std::vector<std::size_t> order;
+    std::vector<bool> placed(entryCount, false);
+    std::vector<std::vector<std::size_t>> sectionOrders(entryCount);
+    std::string line;
+    while (std::getline(trace, line)) {
+        std::size_t const tab = line.find('\t');
+        std::string const name = normalizePath(line.data(), std::min(tab, line.size()));
+        auto const found = indexByName.find(name);
+        // assets renamed or dropped since the trace was recorded
+        if (found == indexByName.end()) {
+            continue;
+        }
+        std::size_t const index = found->second;
+        if (!placed[index]) {
+            placed[index] = true;
+            order.push_back(index);
+        }
+        if (tab != std::string::npos) {
+            std::size_t const section = std::strtoull(line.c_str() + tab + 1, nullptr, 10);
+            std::vector<std::size_t>& sections = sectionOrders[index];
+            if (std::find(sections.begin(), sections.end(), section) == sections.end()) {
+                sections.push_back(section);
+            }
+        }
+    }
+
+    // the rest keep the order they were written in
+    std::vector<std::size_t> untraced;
+    for (std::size_t i = 0; i < entryCount; i++) {
+        if (!placed[i]) {
+            untraced.push_back(i);
+        }
+    }
+    std::sort(untraced.begin(), untraced.end(), [&](std::size_t one, std::size_t other) {
+        return reader->Entry(one).offset < reader->Entry(other).offset;
+    });
+    order.insert(order.end(), untraced.begin(), untraced.end());
+
+    // written aside and renamed once complete, the source stays mapped meanwhile and may be
+    // the destination itself
+    std::string const temporary = std::string{ destPath } + ".tmp";
+    std::unique_ptr<PakWriter> writer = PakWriter::Create(temporary.c_str(), reader->Chunked());
+    if (!writer) {
+        return false;
+    }
+    bool written = true;
+    for (std::size_t index : order) {
+        std::vector<std::uint8_t> bytes;
+        if (!reader->EntryBytes(index, bytes)) {
+            std::cerr << "PAK::ERROR" << std::endl
+                << "Can't read " << reader->EntryName(index) << " from " << sourcePath << std::endl;
+            written = false;
+            break;
+        }
+
+        std::vector<Section> sections;
+        if (!sectionOrders[index].empty() && parseContainer(bytes.data(), bytes.size(), sections)) {
+            std::vector<std::size_t> dataOrder;
+            std::vector<bool> ordered(sections.size(), false);
+            for (std::size_t section : sectionOrders[index]) {
+                if (section < sections.size()) {
+                    ordered[section] = true;
+                    dataOrder.push_back(section);
+                }
+            }
+            for (std::size_t section = 0; section < sections.size(); section++) {
+                if (!ordered[section]) {
+                    dataOrder.push_back(section);
+                }
+            }
+            bytes = buildContainer(sections, dataOrder);
+        }
+        if (!writer->Write(reader->EntryName(index).c_str(), bytes)) {
+            written = false;
+            break;
+        }
+    }
+    written = written && writer->Finish();
+    writer.reset();
+    reader.reset();
+    if (written && !replaceFile(temporary, destPath)) {
+        std::cerr << "PAK::ERROR" << std::endl
+            << "Can't replace " << destPath << std::endl;
+        written = false;
+    }
+    if (!written) {
+        std::remove(temporary.c_str());
+    }
+    return written;
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "io.hpp"
+#include "writer.hpp"
+
+// Pak layout:
+//   PakHeader
+//   asset data each aligned to PAK_ALIGNMENT, or in a chunked pak the new chunks of each
+//   asset, back to back from an aligned start
+//   PakEntry[entryCount], sorted by pathHash
+//   PakChunk[chunkCount]
+//   std::uint32_t bucketStarts[(1 << bucketBits) + 1]
+//   std::uint32_t chunkRefs[refCount], each entry's chunks in asset order
+//   path names, referenced by the entries
+// Entries whose top bucketBits hash bits are b sit in [bucketStarts[b], bucketStarts[b + 1]),
+// with about one entry per bucket a lookup touches one bucket pair and one or two entries.
+// A chunked pak cuts every asset into content-defined chunks and stores each distinct chunk
+// once, assets sharing a vertex stream or animation share its chunks and their pages. An asset
+// whose chunks were all new is stored in one piece; one reusing an earlier asset's chunks
+// is scattered and can only be copied out.
+std::uint32_t const PAK_MAGIC = 0x4B415041; // "APAK"
+std::uint32_t const PAK_VERSION = 2;
+std::uint64_t const PAK_ALIGNMENT = 64;
+
+struct PakHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t entryCount;
+    std::uint32_t bucketBits;
+    std::uint64_t indexOffset;
+    std::uint64_t chunksOffset;
+    std::uint64_t bucketsOffset;
+    std::uint64_t refsOffset;
+    std::uint64_t namesOffset;
+    std::uint64_t namesSize;
+    std::uint32_t chunkCount;
+    std::uint32_t refCount;
+};
+
+struct PakEntry
+{
+    std::uint64_t pathHash;
+    // where the data starts, the first chunk's data for a chunked entry
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t nameOffset;
+    std::uint32_t nameSize;
+    // [firstRef, firstRef + refCount) in chunkRefs, empty when the data is stored whole
+    std::uint32_t firstRef;
+    std::uint32_t refCount;
+};
+
+struct PakChunk
+{
+    std::uint64_t offset;
+    std::uint32_t size;
+    // how many entries reference the chunk, counting repeats within one entry
+    std::uint32_t refCount;
+};
+
+struct PakStats
+{
+    std::uint64_t assets;
+    std::uint64_t assetBytes;
+    std::uint64_t chunks;
+    std::uint64_t chunkRefs;
+    // asset or chunk data actually written, without alignment
+    std::uint64_t storedBytes;
+    // chunked assets whose chunks aren't back to back, Find can't point at them
+    std::uint64_t scatteredAssets;
+};
+
+// XXH64 of the path with backslashes turned into slashes, loaders hash the same way.
+std::uint64_t pakPathHash(char const* path, std::size_t length);
+
+// Collects converted outputs into one pak as they are written, from any number of workers.
+// Asset data is appended as it arrives, the index is written by Finish. chunked stores
+// each distinct chunk once instead of whole assets.
+class PakWriter : public OutputWriter
+{
+public:
+    static std::unique_ptr<PakWriter> Create(char const* path, bool chunked = false);
+
+    bool Write(char const* destName, std::vector<std::uint8_t> const& bytes) override;
+    bool Finish();
+
+    PakStats Stats() const;
+
+private:
+    struct Pending
+    {
+        std::string name;
+        std::uint64_t pathHash;
+        std::uint64_t offset;
+        std::uint64_t size;
+        std::vector<std::uint32_t> chunks;
+        bool scattered;
+    };
+
+    PakWriter(std::string path, bool chunked);
+
+    // Appends data, at the next aligned offset unless it continues the previous append, with
+    // mutex_ held.
+    bool Append(std::uint8_t const* data, std::size_t size, bool aligned, std::uint64_t& offset);
+
+    std::string const path_;
+    bool const chunked_;
+    mutable std::mutex mutex_;
+    std::ofstream file_;
+    std::uint64_t offset_ = 0;
+    std::vector<Pending> pending_;
+    std::vector<PakChunk> chunks_;
+    // chunk content hash to its index in chunks_
+    std::unordered_map<std::uint64_t, std::uint32_t> chunkIndex_;
+    std::uint64_t assetBytes_ = 0;
+    std::uint64_t storedBytes_ = 0;
+};
+
+// Content-defined chunk boundaries of one asset, the end offset of every chunk. A container
+// is also cut where each section starts and ends, so a section lands in the same chunks
+// whichever container it is in and wherever it sits there.
+std::vector<std::size_t> pakChunkBoundaries(std::uint8_t const* data, std::size_t size);
+// The parts of it: 0, size and the start and end of every section for a container, the data
+// between two of them is cut by content alone, appending every chunk's end to boundaries.
+std::vector<std::size_t> pakSectionBoundaries(std::uint8_t const* data, std::size_t size);
+void pakContentBoundaries(std::uint8_t const* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& boundaries);
+
+// Rewrites the pak at sourcePath to destPath with the assets in the order a loader first touched
+// them, as recorded by PakReader::WriteAccessTrace, and each container's section data in the
+// order its sections were first read. Untraced assets follow in their previous order. A
+// chunked pak stays chunked.
+bool relayoutPak(char const* sourcePath, char const* destPath, char const* tracePath);
+
+// Resolves asset paths to their bytes inside one mapping of the whole pak.
+class PakReader
+{
+public:
+    static std::unique_ptr<PakReader> Open(char const* path);
+
+    // data points into the mapping and lives as long as the reader. Data whose chunks aren't
+    // back to back in the pak has no single pointer: Find and FindSection fail for it, count
+    // it in ScatteredLookups, and Read or ReadSection copy it out instead.
+    bool Find(char const* path, std::uint8_t const*& data, std::size_t& size) const;
+    // One section of the container stored under path, by its index in the section table.
+    bool FindSection(char const* path, std::size_t section, std::uint8_t const*& data, std::size_t& size) const;
+    bool Read(char const* path, std::vector<std::uint8_t>& bytes) const;
+    bool ReadSection(char const* path, std::size_t section, std::vector<std::uint8_t>& bytes) const;
+    std::uint64_t ScatteredLookups() const { return scatteredLookups_; }
+
+    // Records every asset and section looked up from here on, in first-use order, for
+    // relayoutPak to place them in that order in the next build.
+    void StartAccessTrace();
+    bool WriteAccessTrace(char const* path) const;
+
+    std::size_t EntryCount() const { return header_.entryCount; }
+    PakEntry const& Entry(std::size_t index) const { return entries_[index]; }
+    std::string EntryName(std::size_t index) const;
+    bool EntryBytes(std::size_t index, std::vector<std::uint8_t>& bytes) const;
+    bool Chunked() const { return header_.chunkCount > 0; }
+    std::size_t ChunkCount() const { return header_.chunkCount; }
+    PakChunk const& Chunk(std::size_t index) const { return chunks_[index]; }
+    // The chunk indices of one entry, empty when it is stored whole.
+    std::uint32_t const* EntryChunks(std::size_t index) const { return refs_ + entries_[index].firstRef; }
+
+private:
+    PakReader() = default;
+
+    bool FindEntry(char const* path, std::size_t& index) const;
+    // Where the section's bytes sit within the entry's data.
+    bool SectionRange(std::size_t index, std::size_t section, std::uint64_t& offset, std::uint64_t& size) const;
+    // The entry's bytes [offset, offset + size) in the mapping, null when the chunks they span
+    // aren't back to back.
+    std::uint8_t const* EntryRange(std::size_t index, std::uint64_t offset, std::uint64_t size) const;
+    bool CopyRange(std::size_t index, std::uint64_t offset, std::uint64_t size, std::uint8_t* out) const;
+    void RecordAccess(std::size_t index, std::int64_t section) const;
+
+    std::shared_ptr<MappedFile> file_;
+    PakHeader header_;
+    PakEntry const* entries_ = nullptr;
+    PakChunk const* chunks_ = nullptr;
+    std::uint32_t const* buckets_ = nullptr;
+    std::uint32_t const* refs_ = nullptr;
+    char const* names_ = nullptr;
+
+    mutable std::atomic<std::uint64_t> scatteredLookups_{ 0 };
+    std::atomic<bool> tracing_{ false };
+    mutable std::mutex traceMutex_;
+    // entry index and section, -1 for a whole asset
+    mutable std::vector<std::pair<std::size_t, std::int64_t>> accesses_;
+    mutable std::set<std::pair<std::size_t, std::int64_t>> accessed_;
+};
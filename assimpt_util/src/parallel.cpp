@@ -0,0 +1,24 @@
+#include "parallel.hpp"
+
+namespace
+{
+
+thread_local bool parallelWorker = false;
+
+}
+
+ParallelWorkerScope::ParallelWorkerScope()
+    : previous_{ parallelWorker }
+{
+    parallelWorker = true;
+}
+
+ParallelWorkerScope::~ParallelWorkerScope()
+{
+    parallelWorker = previous_;
+}
+
+bool onParallelWorker()
+{
+    return parallelWorker;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Marks the current thread as one of a pool that already keeps every core busy, for as long
+// as the scope lives. Batch, pipeline, daemon and watch workers all hold one.
+class ParallelWorkerScope
+{
+public:
+    ParallelWorkerScope();
+    ~ParallelWorkerScope();
+
+    ParallelWorkerScope(ParallelWorkerScope const&) = delete;
+    ParallelWorkerScope& operator=(ParallelWorkerScope const&) = delete;
+
+private:
+    bool const previous_;
+};
+
+bool onParallelWorker();
+
+// Calls function(i) for every i in [0, count) on up to hardware_concurrency threads.
+// Called from a worker it runs inline, nesting would start hardware_concurrency threads
+// on every worker.
+template<typename Function>
+void parallelFor(std::size_t count, Function const& function)
+{
+    if (onParallelWorker()) {
+        for (std::size_t i = 0; i < count; i++) {
+            function(i);
+        }
+        return;
+    }
+
+    std::size_t const hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t const threadCount = std::min(count, hardwareThreads);
+
+    std::atomic<std::size_t> next{ 0 };
+    auto worker = [&]() {
+        ParallelWorkerScope scope;
+        for (std::size_t i = next++; i < count; i = next++) {
+            function(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
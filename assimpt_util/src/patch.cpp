@@ -0,0 +1,310 @@
+#include "patch.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash.hpp"
+#include "io.hpp"
+#include "pak.hpp"
+#include "parallel.hpp"
+
+namespace
+{
+
+struct Piece
+{
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t hash;
+};
+
+std::uint64_t hashBytes(std::uint8_t const* data, std::size_t size)
+{
+    ContentHash hash;
+    if (size > 0) {
+        hash.Update(data, size);
+    }
+    return hash.Digest();
+}
+
+// Spans are cut in windows of this size on every worker. Where a window starts, the cuts
+// running on from the previous one are followed until they meet one of the window's own.
+std::size_t const CUT_WINDOW = 1024 * 1024;
+std::size_t const RESYNC_SCAN = 256 * 1024;
+
+struct CutWindow
+{
+    std::size_t begin;
+    std::size_t end;
+    // parts are whole spans or one section of a container span, each starts with a cut
+    bool firstOfPart;
+};
+
+// Appends the cuts of a window joined to the ones before it. Cutting from a cut is
+// deterministic, so once the cuts carried on from the previous window meet one of the window's
+// own, the rest agree and the result is the same as cutting the whole part in one pass.
+void joinWindow(std::uint8_t const* data, CutWindow const& window, std::vector<std::size_t> const& own,
+    std::vector<std::size_t>& boundaries)
+{
+    if (window.firstOfPart) {
+        boundaries.insert(boundaries.end(), own.begin(), own.end());
+        return;
+    }
+    // the previous window's end was only where it stopped, not a cut
+    boundaries.pop_back();
+    std::size_t last = boundaries.empty() ? 0 : boundaries.back();
+    std::size_t scanEnd = std::min(last + RESYNC_SCAN, window.end);
+    std::vector<std::size_t> carried;
+    for (;;) {
+        carried.clear();
+        pakContentBoundaries(data, last, scanEnd, carried);
+        for (std::size_t cut : carried) {
+            // as far as the scan went, not a cut either
+            if (cut == scanEnd && scanEnd < window.end) {
+                break;
+            }
+            boundaries.push_back(cut);
+            last = cut;
+            auto const met = std::lower_bound(own.begin(), own.end(), cut);
+            if (met != own.end() && *met == cut) {
+                boundaries.insert(boundaries.end(), met + 1, own.end());
+                return;
+            }
+        }
+        // the window's end is its own last cut, a full scan always meets it
+        scanEnd = window.end;
+    }
+}
+
+// A pak is split at its assets or chunks first, so an asset moved by a rebuild still
+// matches, and the spans between them (header, padding, index) are pieces of their own.
+// Every span is then cut like a pak chunks an asset: at section boundaries and by content.
+std::vector<Piece> cutPieces(char const* path, MappedFile const& file)
+{
+    std::uint64_t const size = file.Size();
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> regions;
+    std::uint32_t magic = 0;
+    if (size >= sizeof(magic)) {
+        std::memcpy(&magic, file.Data(), sizeof(magic));
+    }
+    std::unique_ptr<PakReader> pak = magic == PAK_MAGIC ? PakReader::Open(path) : nullptr;
+    if (pak) {
+        for (std::size_t i = 0; i < pak->EntryCount(); i++) {
+            PakEntry const& entry = pak->Entry(i);
+            if (entry.refCount == 0 && entry.size > 0) {
+                regions.emplace_back(entry.offset, entry.size);
+            }
+        }
+        for (std::size_t i = 0; i < pak->ChunkCount(); i++) {
+            regions.emplace_back(pak->Chunk(i).offset, pak->Chunk(i).size);
+        }
+        std::sort(regions.begin(), regions.end());
+    }
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> spans;
+    std::uint64_t cursor = 0;
+    for (auto const& region : regions) {
+        if (region.second == 0 || region.first < cursor) {
+            continue;
+        }
+        if (region.first > cursor) {
+            spans.emplace_back(cursor, region.first - cursor);
+        }
+        spans.push_back(region);
+        cursor = region.first + region.second;
+    }
+    if (cursor < size) {
+        spans.emplace_back(cursor, size - cursor);
+    }
+
+    // a whole build that isn't a pak is one span, windows keep every worker busy on it too
+    std::uint8_t const* data = file.Data();
+    std::vector<CutWindow> windows;
+    for (auto const& span : spans) {
+        std::size_t const spanBegin = static_cast<std::size_t>(span.first);
+        std::vector<std::size_t> const parts = pakSectionBoundaries(data + spanBegin, static_cast<std::size_t>(span.second));
+        for (std::size_t i = 1; i < parts.size(); i++) {
+            std::size_t const partEnd = spanBegin + parts[i];
+            for (std::size_t begin = spanBegin + parts[i - 1]; begin < partEnd; begin += CUT_WINDOW) {
+                windows.push_back(CutWindow{ begin, std::min(begin + CUT_WINDOW, partEnd), begin == spanBegin + parts[i - 1] });
+            }
+        }
+    }
+    std::vector<std::vector<std::size_t>> windowCuts(windows.size());
+    parallelFor(windows.size(), [&](std::size_t i) {
+        pakContentBoundaries(data, windows[i].begin, windows[i].end, windowCuts[i]);
+    });
+
+    std::vector<std::size_t> boundaries;
+    for (std::size_t i = 0; i < windows.size(); i++) {
+        joinWindow(data, windows[i], windowCuts[i], boundaries);
+    }
+
+    std::vector<Piece> pieces(boundaries.size());
+    parallelFor(pieces.size(), [&](std::size_t i) {
+        std::size_t const start = i > 0 ? boundaries[i - 1] : 0;
+        pieces[i] = Piece{ start, boundaries[i] - start, hashBytes(data + start, boundaries[i] - start) };
+    });
+    return pieces;
+}
+
+}
+
+bool diffBuilds(char const* oldPath, char const* newPath, char const* patchPath)
+{
+    std::shared_ptr<MappedFile> const oldFile = MappedFile::Open(oldPath);
+    std::shared_ptr<MappedFile> const newFile = MappedFile::Open(newPath);
+    if (!oldFile || !newFile) {
+        std::cerr << "PATCH::ERROR" << std::endl
+            << "Can't read " << (oldFile ? newPath : oldPath) << std::endl;
+        return false;
+    }
+
+    PatchHeader header;
+    std::memset(&header, 0, sizeof(header));
+    // one build after the other, each already spreads its spans over every worker
+    std::vector<Piece> const oldPieces = cutPieces(oldPath, *oldFile);
+    std::vector<Piece> const newPieces = cutPieces(newPath, *newFile);
+    header.oldHash = hashBytes(oldFile->Data(), oldFile->Size());
+    header.newHash = hashBytes(newFile->Data(), newFile->Size());
+
+    std::unordered_map<std::uint64_t, Piece const*> oldByHash;
+    for (Piece const& piece : oldPieces) {
+        oldByHash.emplace(piece.hash, &piece);
+    }
+
+    // each insert op's bytes, by offset in the new build
+    std::vector<PatchOp> ops;
+    std::vector<std::uint64_t> insertSources;
+    for (Piece const& piece : newPieces) {
+        std::uint8_t const* data = newFile->Data() + piece.offset;
+        auto const matches = [&](std::uint64_t offset) {
+            return offset <= oldFile->Size() && piece.size <= oldFile->Size() - offset &&
+                std::memcmp(oldFile->Data() + offset, data, static_cast<std::size_t>(piece.size)) == 0;
+        };
+        // the old bytes right after the previous copy come first, repeated pieces such as
+        // padding would otherwise break one long copy into many
+        bool copy = false;
+        std::uint64_t offset = header.literalSize;
+        if (!ops.empty() && ops.back().kind == static_cast<std::uint32_t>(PatchOpKind::Copy) &&
+            matches(ops.back().offset + ops.back().size)) {
+            copy = true;
+            offset = ops.back().offset + ops.back().size;
+        }
+        else {
+            // a matching hash is confirmed against the old bytes, a patch never relies on it alone
+            auto const found = oldByHash.find(piece.hash);
+            if (found != oldByHash.end() && found->second->size == piece.size && matches(found->second->offset)) {
+                copy = true;
+                offset = found->second->offset;
+            }
+        }
+        PatchOpKind const kind = copy ? PatchOpKind::Copy : PatchOpKind::Insert;
+        if (!ops.empty() && ops.back().kind == static_cast<std::uint32_t>(kind) && ops.back().offset + ops.back().size == offset) {
+            ops.back().size += piece.size;
+        }
+        else {
+            ops.push_back(PatchOp{ static_cast<std::uint32_t>(kind), 0, offset, piece.size });
+            insertSources.push_back(piece.offset);
+        }
+        if (!copy) {
+            header.literalSize += piece.size;
+        }
+    }
+
+    header.magic = PATCH_MAGIC;
+    header.version = PATCH_VERSION;
+    header.opCount = ops.size();
+    header.oldSize = oldFile->Size();
+    header.newSize = newFile->Size();
+
+    std::ofstream file{ patchPath, std::ios::binary | std::ios::trunc };
+    file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+    file.write(reinterpret_cast<char const*>(ops.data()), static_cast<std::streamsize>(sizeof(PatchOp) * ops.size()));
+    for (std::size_t i = 0; i < ops.size(); i++) {
+        if (ops[i].kind == static_cast<std::uint32_t>(PatchOpKind::Insert)) {
+            file.write(reinterpret_cast<char const*>(newFile->Data() + insertSources[i]), static_cast<std::streamsize>(ops[i].size));
+        }
+    }
+    file.close();
+    if (!file) {
+        std::cerr << "PATCH::ERROR" << std::endl
+            << "Can't write the patch " << patchPath << std::endl;
+        return false;
+    }
+    std::cout << "Patch: " << header.literalSize << " of " << header.newSize << " bytes changed, "
+        << ops.size() << " ops" << std::endl;
+    return true;
+}
+
+bool applyPatch(char const* oldPath, char const* patchPath, char const* newPath)
+{
+    std::shared_ptr<MappedFile> oldFile = MappedFile::Open(oldPath);
+    std::shared_ptr<MappedFile> patch = MappedFile::Open(patchPath);
+    if (!oldFile || !patch) {
+        std::cerr << "PATCH::ERROR" << std::endl
+            << "Can't read " << (oldFile ? patchPath : oldPath) << std::endl;
+        return false;
+    }
+
+    PatchHeader header;
+    std::uint64_t const patchSize = patch->Size();
+    bool valid = patchSize >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, patch->Data(), sizeof(header));
+        valid = header.magic == PATCH_MAGIC && header.version == PATCH_VERSION &&
+            header.opCount <= (patchSize - sizeof(header)) / sizeof(PatchOp) &&
+            header.literalSize == patchSize - sizeof(header) - sizeof(PatchOp) * header.opCount;
+    }
+    if (!valid) {
+        std::cerr << "PATCH::ERROR" << std::endl
+            << patchPath << " is not a valid patch" << std::endl;
+        return false;
+    }
+    if (header.oldSize != oldFile->Size() || header.oldHash != hashBytes(oldFile->Data(), oldFile->Size())) {
+        std::cerr << "PATCH::ERROR" << std::endl
+            << patchPath << " was made against a different build than " << oldPath << std::endl;
+        return false;
+    }
+
+    // written aside and renamed once verified, the old build stays mapped meanwhile and may be
+    // the destination itself
+    std::string const temporary = std::string{ newPath } + ".tmp";
+    std::uint8_t const* literals = patch->Data() + sizeof(header) + sizeof(PatchOp) * header.opCount;
+    std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+    ContentHash hash;
+    std::uint64_t written = 0;
+    for (std::uint64_t i = 0; valid && i < header.opCount; i++) {
+        PatchOp op;
+        std::memcpy(&op, patch->Data() + sizeof(header) + sizeof(PatchOp) * i, sizeof(op));
+        bool const copy = op.kind == static_cast<std::uint32_t>(PatchOpKind::Copy);
+        std::uint64_t const sourceSize = copy ? oldFile->Size() : header.literalSize;
+        valid = (copy || op.kind == static_cast<std::uint32_t>(PatchOpKind::Insert)) &&
+            op.offset <= sourceSize && op.size <= sourceSize - op.offset;
+        if (valid) {
+            std::uint8_t const* data = (copy ? oldFile->Data() : literals) + op.offset;
+            file.write(reinterpret_cast<char const*>(data), static_cast<std::streamsize>(op.size));
+            hash.Update(data, static_cast<std::size_t>(op.size));
+            written += op.size;
+        }
+    }
+    file.close();
+    oldFile.reset();
+    patch.reset();
+    if (!valid || !file || written != header.newSize || hash.Digest() != header.newHash ||
+        !replaceFile(temporary, newPath)) {
+        std::cerr << "PATCH::ERROR" << std::endl
+            << "Can't rebuild " << newPath << " from " << patchPath << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
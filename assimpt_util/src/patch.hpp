@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+// Patch layout:
+//   PatchHeader
+//   PatchOp[opCount]
+//   literal bytes, referenced by the insert ops
+// Applying the ops in order to the old file writes the new one. The whole-file hashes let
+// apply refuse the wrong base and check its result.
+std::uint32_t const PATCH_MAGIC = 0x54415041; // "APAT"
+std::uint32_t const PATCH_VERSION = 1;
+
+enum class PatchOpKind : std::uint32_t
+{
+    // offset is in the old file
+    Copy = 0,
+    // offset is in the literal bytes
+    Insert = 1,
+};
+
+struct PatchHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t opCount;
+    std::uint64_t literalSize;
+    std::uint64_t oldSize;
+    std::uint64_t oldHash;
+    std::uint64_t newSize;
+    std::uint64_t newHash;
+};
+
+struct PatchOp
+{
+    std::uint32_t kind;
+    std::uint32_t reserved;
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+// Cuts both builds into sections, pak chunks or content-defined chunks and writes a patch
+// holding only the pieces of newPath not found anywhere in oldPath. Works on containers,
+// paks and, less finely, any other file.
+bool diffBuilds(char const* oldPath, char const* newPath, char const* patchPath);
+// Writes newPath from oldPath and a patch made by diffBuilds against it.
+bool applyPatch(char const* oldPath, char const* patchPath, char const* newPath);
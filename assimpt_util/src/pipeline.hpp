@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// Hands items from one pipeline stage to the next. Push blocks while capacity items are
+// waiting, which keeps a fast stage from running arbitrarily far ahead of a slow one.
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_{ capacity } { }
+
+    // False once the queue is closed, the item is then dropped.
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock{ mutex_ };
+        notFull_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // False once the queue is closed and every item has been taken.
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock{ mutex_ };
+        notEmpty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    // The producers are done, consumers drain what is left.
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::size_t const capacity_;
+    std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
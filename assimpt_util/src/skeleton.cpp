@@ -0,0 +1,82 @@
+#include "skeleton.hpp"
+
+#include <iostream>
+#include <string>
+
+#include "hash.hpp"
+
+namespace
+{
+
+Matrix3x4 const IDENTITY = { {
+    { 1.0f, 0.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f, 0.0f },
+    { 0.0f, 0.0f, 1.0f, 0.0f },
+} };
+
+std::int32_t findNode(NodeHierarchy const& hierarchy, aiString const& name)
+{
+    auto const node = hierarchy.indexByName.find(std::string{ name.C_Str() });
+    return node != hierarchy.indexByName.end() ? static_cast<std::int32_t>(node->second) : -1;
+}
+
+}
+
+Skeleton buildSkeleton(aiScene const* scene, NodeHierarchy const& hierarchy, std::vector<std::int32_t>& jointByNode)
+{
+    // the first bone referencing a node provides its inverse bind matrix
+    std::vector<aiBone const*> boneByNode(hierarchy.nodes.size(), nullptr);
+    std::vector<bool> used(hierarchy.nodes.size(), false);
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        aiMesh const* mesh = scene->mMeshes[i];
+        for (unsigned int j = 0; j < mesh->mNumBones; j++) {
+            std::int32_t node = findNode(hierarchy, mesh->mBones[j]->mName);
+            if (node < 0) {
+                continue;
+            }
+            if (!boneByNode[node]) {
+                boneByNode[node] = mesh->mBones[j];
+            }
+            for (; node >= 0 && !used[node]; node = hierarchy.parents[node]) {
+                used[node] = true;
+            }
+        }
+    }
+
+    // the hierarchy is already parent-first, so keeping its order keeps the skeleton sorted
+    Skeleton skeleton;
+    jointByNode.assign(hierarchy.nodes.size(), -1);
+    for (std::size_t i = 0; i < hierarchy.nodes.size(); i++) {
+        if (!used[i]) {
+            continue;
+        }
+        aiNode const* node = hierarchy.nodes[i];
+        std::int32_t const parent = hierarchy.parents[i];
+
+        jointByNode[i] = static_cast<std::int32_t>(skeleton.parents.size());
+        skeleton.nameHashes.push_back(hashName(node->mName.C_Str(), node->mName.length));
+        skeleton.parents.push_back(parent >= 0 ? jointByNode[parent] : -1);
+        skeleton.localBindTransforms.push_back(toMatrix3x4(node->mTransformation));
+        skeleton.inverseBindMatrices.push_back(boneByNode[i] ? toMatrix3x4(boneByNode[i]->mOffsetMatrix) : IDENTITY);
+    }
+    return skeleton;
+}
+
+bool remapJoints(aiMesh const* mesh, NodeHierarchy const& hierarchy, std::vector<std::int32_t> const& jointByNode,
+    std::vector<std::uint32_t>& remap)
+{
+    remap.assign(mesh->mNumBones, 0);
+    for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+        std::int32_t const node = findNode(hierarchy, mesh->mBones[i]->mName);
+        if (node < 0 || jointByNode[node] < 0) {
+            // joint 0 would silently skin these vertices to the root
+            std::cerr << "SKELETON::ERROR" << std::endl
+                << "Bone " << mesh->mBones[i]->mName.C_Str() << " of mesh " << mesh->mName.C_Str()
+                << " has no joint in the skeleton, the mesh's joint remap is left out" << std::endl;
+            remap.clear();
+            return false;
+        }
+        remap[i] = static_cast<std::uint32_t>(jointByNode[node]);
+    }
+    return true;
+}
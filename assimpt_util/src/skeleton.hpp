@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <assimp\scene.h>
+
+#include "animation.hpp"
+#include "data.hpp"
+
+// Builds a skeleton from every node referenced by an aiBone of any mesh plus all of
+// its ancestors, so local-to-model evaluation is a single loop over the joint array.
+// jointByNode receives the joint index of every hierarchy node, or -1.
+Skeleton buildSkeleton(aiScene const* scene, NodeHierarchy const& hierarchy, std::vector<std::int32_t>& jointByNode);
+
+// Joint index for every aiBone of the mesh, in mBones order. False when a bone has no
+// joint, the mesh then can't be skinned against the skeleton.
+bool remapJoints(aiMesh const* mesh, NodeHierarchy const& hierarchy, std::vector<std::int32_t> const& jointByNode,
+    std::vector<std::uint32_t>& remap);
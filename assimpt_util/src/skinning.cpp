@@ -0,0 +1,193 @@
+#include "skinning.hpp"
+
+#include <cmath>
+#include <limits>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKINNING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+std::uint32_t const MISSING_NODE = std::numeric_limits<std::uint32_t>::max();
+
+void storeNormalized(float const* xyz, float* out)
+{
+    float const length = std::sqrt(xyz[0] * xyz[0] + xyz[1] * xyz[1] + xyz[2] * xyz[2]);
+    float const scale = length > 0.0f ? 1.0f / length : 0.0f;
+    out[0] = xyz[0] * scale;
+    out[1] = xyz[1] * scale;
+    out[2] = xyz[2] * scale;
+}
+
+// Normals take the inverse transpose of the blended matrix, which stays correct under
+// non-uniform scale. Its rows are the cofactor rows over the determinant; the length is
+// renormalized anyway, so only the determinant's sign is applied.
+void storeSkinnedNormal(float const (&m)[3][4], aiVector3D const& normal, float* out)
+{
+    float const cofactors[3][3] = {
+        { m[1][1] * m[2][2] - m[1][2] * m[2][1], m[1][2] * m[2][0] - m[1][0] * m[2][2], m[1][0] * m[2][1] - m[1][1] * m[2][0] },
+        { m[2][1] * m[0][2] - m[2][2] * m[0][1], m[2][2] * m[0][0] - m[2][0] * m[0][2], m[2][0] * m[0][1] - m[2][1] * m[0][0] },
+        { m[0][1] * m[1][2] - m[0][2] * m[1][1], m[0][2] * m[1][0] - m[0][0] * m[1][2], m[0][0] * m[1][1] - m[0][1] * m[1][0] },
+    };
+    float const determinant = m[0][0] * cofactors[0][0] + m[0][1] * cofactors[0][1] + m[0][2] * cofactors[0][2];
+    float const sign = determinant < 0.0f ? -1.0f : 1.0f;
+    float result[3];
+    for (int row = 0; row < 3; row++) {
+        result[row] = sign * (cofactors[row][0] * normal.x + cofactors[row][1] * normal.y + cofactors[row][2] * normal.z);
+    }
+    storeNormalized(result, out);
+}
+
+#ifdef SKINNING_SSE2
+
+// Returns (dot(r0, v), dot(r1, v), dot(r2, v), 0).
+__m128 transform(__m128 r0, __m128 r1, __m128 r2, __m128 v)
+{
+    __m128 t0 = _mm_mul_ps(r0, v);
+    __m128 t1 = _mm_mul_ps(r1, v);
+    __m128 t2 = _mm_mul_ps(r2, v);
+    __m128 t3 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+    return _mm_add_ps(_mm_add_ps(t0, t1), _mm_add_ps(t2, t3));
+}
+
+void skinVertex(SkinBinding const& binding, std::vector<SkinMatrix> const& skinMatrices, std::uint32_t vertex,
+    aiVector3D const& position, aiVector3D const* normal, float* outPosition, float* outNormal)
+{
+    __m128 r0 = _mm_setzero_ps();
+    __m128 r1 = _mm_setzero_ps();
+    __m128 r2 = _mm_setzero_ps();
+    for (std::uint32_t i = binding.influenceOffsets[vertex]; i < binding.influenceOffsets[vertex + 1]; i++) {
+        SkinMatrix const& m = skinMatrices[binding.influenceBones[i]];
+        __m128 const weight = _mm_set1_ps(binding.influenceWeights[i]);
+        r0 = _mm_add_ps(r0, _mm_mul_ps(weight, _mm_loadu_ps(m.rows[0])));
+        r1 = _mm_add_ps(r1, _mm_mul_ps(weight, _mm_loadu_ps(m.rows[1])));
+        r2 = _mm_add_ps(r2, _mm_mul_ps(weight, _mm_loadu_ps(m.rows[2])));
+    }
+
+    float result[4];
+    _mm_storeu_ps(result, transform(r0, r1, r2, _mm_set_ps(1.0f, position.z, position.y, position.x)));
+    outPosition[0] = result[0];
+    outPosition[1] = result[1];
+    outPosition[2] = result[2];
+
+    if (normal) {
+        float m[3][4];
+        _mm_storeu_ps(m[0], r0);
+        _mm_storeu_ps(m[1], r1);
+        _mm_storeu_ps(m[2], r2);
+        storeSkinnedNormal(m, *normal, outNormal);
+    }
+}
+
+#else
+
+void skinVertex(SkinBinding const& binding, std::vector<SkinMatrix> const& skinMatrices, std::uint32_t vertex,
+    aiVector3D const& position, aiVector3D const* normal, float* outPosition, float* outNormal)
+{
+    float m[3][4] = {};
+    for (std::uint32_t i = binding.influenceOffsets[vertex]; i < binding.influenceOffsets[vertex + 1]; i++) {
+        SkinMatrix const& bone = skinMatrices[binding.influenceBones[i]];
+        float const weight = binding.influenceWeights[i];
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 4; column++) {
+                m[row][column] += weight * bone.rows[row][column];
+            }
+        }
+    }
+
+    for (int row = 0; row < 3; row++) {
+        outPosition[row] = m[row][0] * position.x + m[row][1] * position.y + m[row][2] * position.z + m[row][3];
+    }
+
+    if (normal) {
+        storeSkinnedNormal(m, *normal, outNormal);
+    }
+}
+
+#endif
+
+}
+
+SkinBinding bindSkin(aiMesh const* mesh, NodeHierarchy const& hierarchy)
+{
+    SkinBinding binding;
+    binding.influenceOffsets.assign(mesh->mNumVertices + 1, 0);
+
+    for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+        aiBone const* bone = mesh->mBones[i];
+        auto const node = hierarchy.indexByName.find(std::string{ bone->mName.C_Str() });
+        binding.boneNodes.push_back(node != hierarchy.indexByName.end() ? node->second : MISSING_NODE);
+        binding.offsetMatrices.push_back(bone->mOffsetMatrix);
+
+        for (unsigned int j = 0; j < bone->mNumWeights; j++) {
+            if (bone->mWeights[j].mVertexId < mesh->mNumVertices) {
+                binding.influenceOffsets[bone->mWeights[j].mVertexId + 1]++;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+        binding.influenceOffsets[i + 1] += binding.influenceOffsets[i];
+    }
+
+    std::uint32_t const influenceCount = binding.influenceOffsets[mesh->mNumVertices];
+    binding.influenceBones.resize(influenceCount);
+    binding.influenceWeights.resize(influenceCount);
+
+    std::vector<std::uint32_t> cursor(binding.influenceOffsets.begin(), binding.influenceOffsets.end() - 1);
+    for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+        aiBone const* bone = mesh->mBones[i];
+        for (unsigned int j = 0; j < bone->mNumWeights; j++) {
+            unsigned int const vertex = bone->mWeights[j].mVertexId;
+            if (vertex < mesh->mNumVertices) {
+                binding.influenceBones[cursor[vertex]] = i;
+                binding.influenceWeights[cursor[vertex]] = bone->mWeights[j].mWeight;
+                cursor[vertex]++;
+            }
+        }
+    }
+
+    return binding;
+}
+
+void computeSkinMatrices(SkinBinding const& binding, std::vector<aiMatrix4x4> const& globalTransforms,
+    aiMatrix4x4 const& globalInverse, std::vector<SkinMatrix>& skinMatrices)
+{
+    skinMatrices.resize(binding.boneNodes.size());
+    for (std::size_t i = 0; i < binding.boneNodes.size(); i++) {
+        aiMatrix4x4 const global = binding.boneNodes[i] != MISSING_NODE ? globalTransforms[binding.boneNodes[i]] : aiMatrix4x4{};
+        skinMatrices[i] = toMatrix3x4(globalInverse * global * binding.offsetMatrices[i]);
+    }
+}
+
+void skinVertices(aiMesh const* mesh, SkinBinding const& binding, std::vector<SkinMatrix> const& skinMatrices,
+    std::vector<float>& positions, std::vector<float>& normals)
+{
+    bool const hasNormals = mesh->HasNormals();
+    positions.resize(mesh->mNumVertices * 3);
+    normals.resize(hasNormals ? mesh->mNumVertices * 3 : 0);
+
+    for (std::uint32_t i = 0; i < mesh->mNumVertices; i++) {
+        float* outPosition = &positions[i * 3];
+        float* outNormal = hasNormals ? &normals[i * 3] : nullptr;
+
+        if (binding.influenceOffsets[i] == binding.influenceOffsets[i + 1]) {
+            outPosition[0] = mesh->mVertices[i].x;
+            outPosition[1] = mesh->mVertices[i].y;
+            outPosition[2] = mesh->mVertices[i].z;
+            if (hasNormals) {
+                outNormal[0] = mesh->mNormals[i].x;
+                outNormal[1] = mesh->mNormals[i].y;
+                outNormal[2] = mesh->mNormals[i].z;
+            }
+            continue;
+        }
+
+        skinVertex(binding, skinMatrices, i, mesh->mVertices[i], hasNormals ? &mesh->mNormals[i] : nullptr, outPosition, outNormal);
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <assimp\scene.h>
+
+#include "animation.hpp"
+#include "data.hpp"
+
+using SkinMatrix = Matrix3x4;
+
+// Per-vertex bone influences stored CSR style: influences of vertex i live in
+// [influenceOffsets[i], influenceOffsets[i + 1]).
+struct SkinBinding
+{
+    std::vector<std::uint32_t> boneNodes;
+    std::vector<aiMatrix4x4> offsetMatrices;
+    std::vector<std::uint32_t> influenceOffsets;
+    std::vector<std::uint32_t> influenceBones;
+    std::vector<float> influenceWeights;
+};
+
+SkinBinding bindSkin(aiMesh const* mesh, NodeHierarchy const& hierarchy);
+
+void computeSkinMatrices(SkinBinding const& binding, std::vector<aiMatrix4x4> const& globalTransforms,
+    aiMatrix4x4 const& globalInverse, std::vector<SkinMatrix>& skinMatrices);
+
+// Reference CPU skinning. Positions and normals are written as packed xyz triples,
+// normals are renormalized; vertices without influences keep their bind pose.
+void skinVertices(aiMesh const* mesh, SkinBinding const& binding, std::vector<SkinMatrix> const& skinMatrices,
+    std::vector<float>& positions, std::vector<float>& normals);
@@ -0,0 +1,114 @@
+#include "targets.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include <assimp\cexport.h>
+#include <assimp\postprocess.h>
+
+#include "timing.hpp"
+
+namespace
+{
+
+// Triangulation and handedness are applied once at import, these only add to it.
+unsigned int const CACHE_FLAGS = aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality;
+
+TargetProfile const KNOWN_TARGETS[] = {
+    { "desktop", CACHE_FLAGS },
+    { "console", CACHE_FLAGS | aiProcess_OptimizeMeshes },
+    { "mobile", CACHE_FLAGS | aiProcess_OptimizeMeshes | aiProcess_LimitBoneWeights },
+};
+
+// Exchanges everything but mPrivate, which belongs to the importer that owns the scene.
+void swapSceneContents(aiScene& one, aiScene& other)
+{
+    std::swap(one.mFlags, other.mFlags);
+    std::swap(one.mRootNode, other.mRootNode);
+    std::swap(one.mNumMeshes, other.mNumMeshes);
+    std::swap(one.mMeshes, other.mMeshes);
+    std::swap(one.mNumMaterials, other.mNumMaterials);
+    std::swap(one.mMaterials, other.mMaterials);
+    std::swap(one.mNumAnimations, other.mNumAnimations);
+    std::swap(one.mAnimations, other.mAnimations);
+    std::swap(one.mNumTextures, other.mNumTextures);
+    std::swap(one.mTextures, other.mTextures);
+    std::swap(one.mNumLights, other.mNumLights);
+    std::swap(one.mLights, other.mLights);
+    std::swap(one.mNumCameras, other.mNumCameras);
+    std::swap(one.mCameras, other.mCameras);
+}
+
+aiScene* copyScene(aiScene const* scene)
+{
+    aiScene* copy = nullptr;
+    aiCopyScene(scene, &copy);
+    return copy;
+}
+
+}
+
+bool parseTargetProfiles(std::string const& list, std::vector<TargetProfile>& targets)
+{
+    std::istringstream stream{ list };
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        bool found = false;
+        for (TargetProfile const& target : KNOWN_TARGETS) {
+            if (target.name == name) {
+                targets.push_back(target);
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cerr << "Unknown target " << name << std::endl;
+            return false;
+        }
+    }
+    return !targets.empty();
+}
+
+std::string targetDestName(std::string const& destName, std::string const& target)
+{
+    std::size_t const separator = destName.find_last_of("/\\");
+    std::size_t const dot = destName.find_last_of('.');
+    if (dot == std::string::npos || (separator != std::string::npos && dot < separator)) {
+        return destName + "." + target;
+    }
+    return destName.substr(0, dot) + "." + target + destName.substr(dot);
+}
+
+bool processTargets(Assimp::Importer& importer, std::vector<TargetProfile> const& targets,
+    std::function<void(std::size_t, aiScene const*)> const& process)
+{
+    aiScene* const owned = const_cast<aiScene*>(importer.GetScene());
+
+    // one pristine copy, the last target consumes it instead of copying again
+    aiScene* pristine = targets.size() > 1 ? copyScene(owned) : nullptr;
+    for (std::size_t i = 0; i < targets.size(); i++) {
+        if (i > 0) {
+            ScopedStage stage{ "target copy" };
+            aiScene* source = i + 1 < targets.size() ? copyScene(pristine) : pristine;
+            swapSceneContents(*owned, *source);
+            // source now holds the previous target's processed data
+            aiFreeScene(source);
+        }
+
+        bool processed;
+        {
+            ScopedStage stage{ "target post-process" };
+            processed = importer.ApplyPostProcessing(targets[i].postProcessFlags) != nullptr;
+        }
+        if (!processed) {
+            std::cerr << "ASSIMP::IMPORTER::ERROR" << std::endl
+                << "Post-processing for target " << targets[i].name << " failed: " << importer.GetErrorString() << std::endl;
+            if (i + 1 < targets.size()) {
+                aiFreeScene(pristine);
+            }
+            return false;
+        }
+        process(i, importer.GetScene());
+    }
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <assimp\Importer.hpp>
+#include <assimp\scene.h>
+
+// A platform variant: post-process steps applied on top of the shared import.
+struct TargetProfile
+{
+    std::string name;
+    unsigned int postProcessFlags;
+};
+
+// Parses a comma separated list of known profiles (desktop, console, mobile).
+bool parseTargetProfiles(std::string const& list, std::vector<TargetProfile>& targets);
+
+// "out.bin" + "mobile" -> "out.mobile.bin"
+std::string targetDestName(std::string const& destName, std::string const& target);
+
+// Calls process(i, scene) for every target from the single parse held by importer.
+// Each target after the first starts from a copy of the unprocessed scene, swapped into
+// the importer's own scene because ApplyPostProcessing only works on that one.
+bool processTargets(Assimp::Importer& importer, std::vector<TargetProfile> const& targets,
+    std::function<void(std::size_t, aiScene const*)> const& process);
@@ -0,0 +1,299 @@
+#include "timing.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include <assimp\DefaultLogger.hpp>
+#include <assimp\Logger.hpp>
+
+#include "trace.hpp"
+
+namespace
+{
+
+thread_local AssetTimings* currentAsset = nullptr;
+
+// assimp regions still open on this thread, and the first step that logged inside them
+thread_local std::vector<std::pair<std::string, TimingClock::time_point>> openRegions;
+thread_local std::string currentStep;
+
+double millisecondsBetween(TimingClock::time_point begin, TimingClock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+std::string jsonString(std::string const& text)
+{
+    std::string escaped = "\"";
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            escaped += "\\\"";
+            break;
+        case '\\':
+            escaped += "\\\\";
+            break;
+        case '\n':
+            escaped += "\\n";
+            break;
+        case '\t':
+            escaped += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", c);
+                escaped += code;
+            }
+            else {
+                escaped += c;
+            }
+        }
+    }
+    return escaped + "\"";
+}
+
+// Takes assimp's debug messages straight from the importing thread, "START `postprocess`"
+// and "END   `postprocess`, dt= 0.002 s" among them. DefaultLogger formats every message into
+// shared buffers for its repeat suppression and can't be called from several imports at
+// once; this keeps no state but the calling thread's, so any number of workers may log.
+class TimingLogger : public Assimp::Logger
+{
+public:
+    TimingLogger() : Assimp::Logger{ Assimp::Logger::VERBOSE } { }
+
+    // nothing but the timings listens, streams are refused and stay with the caller
+    bool attachStream(Assimp::LogStream*, unsigned int) override { return false; }
+    bool detatchStream(Assimp::LogStream*, unsigned int) override { return false; }
+
+protected:
+    void OnInfo(char const*) override { }
+    void OnWarn(char const*) override { }
+    void OnError(char const*) override { }
+
+    void OnDebug(char const* text) override
+    {
+        if (!currentAsset) {
+            return;
+        }
+
+        TimingClock::time_point const now = TimingClock::now();
+        if (std::strncmp(text, "START `", 7) == 0) {
+            char const* end = std::strchr(text + 7, '`');
+            if (end) {
+                openRegions.emplace_back(std::string{ text + 7, end }, now);
+                currentStep.clear();
+            }
+            return;
+        }
+        if (std::strncmp(text, "END   `", 7) == 0) {
+            char const* end = std::strchr(text + 7, '`');
+            if (!end) {
+                return;
+            }
+            std::string const name{ text + 7, end };
+            char const* dt = std::strstr(end, "dt= ");
+            AssetTimings::Region region{ name, currentStep, dt ? std::strtod(dt + 4, nullptr) : 0.0, 0.0 };
+            for (std::size_t i = openRegions.size(); i-- > 0; ) {
+                if (openRegions[i].first == name) {
+                    region.wallMs = millisecondsBetween(openRegions[i].second, now);
+                    openRegions.erase(openRegions.begin() + i);
+                    break;
+                }
+            }
+            currentAsset->regions.push_back(std::move(region));
+            currentStep.clear();
+            return;
+        }
+
+        // post-process steps announce themselves as "<Name>Process begin"
+        char const* begin = std::strstr(text, " begin");
+        if (begin && currentStep.empty() && !openRegions.empty() && openRegions.back().first == "postprocess") {
+            currentStep.assign(text, begin);
+        }
+    }
+};
+
+}
+
+void AssetTimings::AddStage(char const* name, TimingClock::time_point begin, TimingClock::time_point end, std::int64_t peakBytes)
+{
+    double const duration = millisecondsBetween(begin, end);
+    for (Stage& stage : stages) {
+        if (stage.name == name) {
+            stage.totalMs += duration;
+            stage.count++;
+            stage.peakBytes = std::max(stage.peakBytes, peakBytes);
+            return;
+        }
+    }
+    stages.push_back(Stage{ name, millisecondsBetween(start, begin), duration, 1, peakBytes });
+}
+
+std::string AssetTimings::ToJson(double totalMs) const
+{
+    std::ostringstream json;
+    json << "{\"source\":" << jsonString(source) << ",\"dest\":" << jsonString(dest) << ",\"total_ms\":" << totalMs;
+
+    json << ",\"stages\":[";
+    for (std::size_t i = 0; i < stages.size(); i++) {
+        json << (i ? "," : "") << "{\"name\":" << jsonString(stages[i].name) << ",\"start_ms\":" << stages[i].startMs
+            << ",\"ms\":" << stages[i].totalMs << ",\"count\":" << stages[i].count << ",\"peak_bytes\":" << stages[i].peakBytes << "}";
+    }
+
+    json << "],\"assimp\":[";
+    for (std::size_t i = 0; i < regions.size(); i++) {
+        json << (i ? "," : "") << "{\"region\":" << jsonString(regions[i].name);
+        if (!regions[i].step.empty()) {
+            json << ",\"step\":" << jsonString(regions[i].step);
+        }
+        json << ",\"ms\":" << regions[i].wallMs << ",\"assimp_s\":" << regions[i].assimpSeconds << "}";
+    }
+
+    json << "],\"progress\":[";
+    for (std::size_t i = 0; i < progress.size(); i++) {
+        json << (i ? "," : "") << "[" << progress[i].ms << "," << progress[i].percentage << "]";
+    }
+    json << "],\"memory\":{";
+    if (hasSceneMemory) {
+        json << "\"scene\":{\"meshes\":" << sceneMemory.meshes << ",\"materials\":" << sceneMemory.materials
+            << ",\"animations\":" << sceneMemory.animations << ",\"nodes\":" << sceneMemory.nodes
+            << ",\"textures\":" << sceneMemory.textures << ",\"cameras\":" << sceneMemory.cameras
+            << ",\"lights\":" << sceneMemory.lights << ",\"total\":" << sceneMemory.total << "},";
+    }
+    json << "\"heap_peak_bytes\":" << heapPeakBytes << ",\"allocations\":" << allocations
+        << ",\"process_peak_rss_bytes\":" << residentPeakBytes << "}}";
+    return json.str();
+}
+
+TimingSink::TimingSink(std::string const& path)
+    : file_{ path, std::ios::app }
+{
+}
+
+void TimingSink::Write(AssetTimings const& timings, double totalMs)
+{
+    std::string const line = timings.ToJson(totalMs);
+    std::lock_guard<std::mutex> lock{ mutex_ };
+    file_ << line << '\n';
+    file_.flush();
+}
+
+AssetRecord::AssetRecord(TimingSink* sink, char const* source, char const* dest)
+    : sink_{ sink }
+    , traced_{ traceEnabled() }
+    , finished_{ !sink && !traced_ }
+{
+    if (finished_) {
+        return;
+    }
+    timings_.source = source;
+    timings_.dest = dest;
+    timings_.start = TimingClock::now();
+}
+
+AssetRecord::~AssetRecord()
+{
+    Finish();
+}
+
+void AssetRecord::Finish()
+{
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+    TimingClock::time_point const end = TimingClock::now();
+    if (traced_) {
+        traceSpan("asset", timings_.source, timings_.start, end, timings_.dest);
+    }
+    if (sink_) {
+        timings_.residentPeakBytes = peakResidentBytes();
+        sink_->Write(timings_, millisecondsBetween(timings_.start, end));
+    }
+}
+
+CurrentAsset::CurrentAsset(AssetRecord& record)
+    : record_{ record.sink_ ? &record : nullptr }
+    , previous_{ currentAsset }
+{
+    if (record_) {
+        currentAsset = &record_->timings_;
+        openRegions.clear();
+        currentStep.clear();
+    }
+}
+
+CurrentAsset::~CurrentAsset()
+{
+    if (record_) {
+        currentAsset = previous_;
+        AssetTimings& timings = record_->timings_;
+        timings.heapPeakBytes = std::max(timings.heapPeakBytes, heap_.PeakBytes());
+        timings.allocations += heap_.Allocations();
+    }
+}
+
+ScopedAsset::ScopedAsset(TimingSink* sink, char const* source, char const* dest)
+    : record_{ sink, source, dest }
+    , current_{ record_ }
+{
+}
+
+ScopedStage::ScopedStage(char const* name)
+    : asset_{ currentAsset }
+    , traced_{ traceEnabled() }
+    , name_{ name }
+    , begin_{ asset_ || traced_ ? TimingClock::now() : TimingClock::time_point{} }
+{
+}
+
+ScopedStage::~ScopedStage()
+{
+    if (!asset_ && !traced_) {
+        return;
+    }
+    TimingClock::time_point const end = TimingClock::now();
+    if (asset_) {
+        asset_->AddStage(name_, begin_, end, heap_.PeakBytes());
+    }
+    if (traced_) {
+        traceSpan("stage", name_, begin_, end);
+    }
+}
+
+void recordSceneMemory(aiMemoryInfo const& info)
+{
+    if (currentAsset) {
+        currentAsset->hasSceneMemory = true;
+        currentAsset->sceneMemory = info;
+    }
+}
+
+bool recordingAsset()
+{
+    return currentAsset != nullptr;
+}
+
+bool TimingProgressHandler::Update(float percentage)
+{
+    if (currentAsset) {
+        currentAsset->progress.push_back(AssetTimings::Progress{ millisecondsBetween(currentAsset->start, TimingClock::now()), percentage });
+    }
+    return true;
+}
+
+void attachTimingLog()
+{
+    // owned by DefaultLogger from here on, kill() deletes it
+    Assimp::DefaultLogger::set(new TimingLogger);
+}
+
+void detachTimingLog()
+{
+    Assimp::DefaultLogger::kill();
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <assimp\ProgressHandler.hpp>
+#include <assimp\types.h>
+
+#include "memory.hpp"
+
+using TimingClock = std::chrono::steady_clock;
+
+// Everything measured while converting one asset.
+struct AssetTimings
+{
+    struct Stage
+    {
+        std::string name;
+        double startMs;
+        double totalMs;
+        std::size_t count;
+        std::int64_t peakBytes;
+    };
+
+    // One assimp profiler region, dt as assimp reports it (process CPU clock) and as we saw it.
+    struct Region
+    {
+        std::string name;
+        std::string step;
+        double assimpSeconds;
+        double wallMs;
+    };
+
+    struct Progress
+    {
+        double ms;
+        float percentage;
+    };
+
+    std::string source;
+    std::string dest;
+    TimingClock::time_point start;
+    std::vector<Stage> stages;
+    std::vector<Region> regions;
+    std::vector<Progress> progress;
+
+    // assimp's breakdown of the imported scene, before any target post-processing
+    bool hasSceneMemory = false;
+    aiMemoryInfo sceneMemory;
+    std::int64_t heapPeakBytes = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t residentPeakBytes = 0;
+
+    // Repeated stages (per mesh, per clip) accumulate into their first entry, keeping the highest peak.
+    void AddStage(char const* name, TimingClock::time_point begin, TimingClock::time_point end, std::int64_t peakBytes);
+    std::string ToJson(double totalMs) const;
+};
+
+// Appends one JSON object per asset and line, shared by every worker.
+class TimingSink
+{
+public:
+    explicit TimingSink(std::string const& path);
+
+    bool IsOpen() const { return static_cast<bool>(file_); }
+    void Write(AssetTimings const& timings, double totalMs);
+
+private:
+    std::mutex mutex_;
+    std::ofstream file_;
+};
+
+// The record of one asset, written once by Finish (or on destruction) and traced as a span
+// when tracing is on. Without either nothing is recorded. Its stages may run on different
+// threads, each making it current with a CurrentAsset.
+class AssetRecord
+{
+public:
+    AssetRecord(TimingSink* sink, char const* source, char const* dest);
+    AssetRecord(AssetRecord const&) = delete;
+    AssetRecord& operator=(AssetRecord const&) = delete;
+    ~AssetRecord();
+
+    void Finish();
+
+private:
+    friend class CurrentAsset;
+
+    TimingSink* sink_;
+    bool const traced_;
+    bool finished_;
+    AssetTimings timings_;
+};
+
+// Makes a record the calling thread's asset for its scope, adding the heap use of the
+// scope to it.
+class CurrentAsset
+{
+public:
+    explicit CurrentAsset(AssetRecord& record);
+    CurrentAsset(CurrentAsset const&) = delete;
+    CurrentAsset& operator=(CurrentAsset const&) = delete;
+    ~CurrentAsset();
+
+private:
+    AssetRecord* record_;
+    AssetTimings* previous_;
+    AllocationScope heap_;
+};
+
+// Records one asset converted entirely on the calling thread.
+class ScopedAsset
+{
+public:
+    ScopedAsset(TimingSink* sink, char const* source, char const* dest);
+
+private:
+    AssetRecord record_;
+    CurrentAsset current_;
+};
+
+// Times its scope as a stage of the asset the calling thread is converting, if any,
+// and traces it when tracing is on.
+class ScopedStage
+{
+public:
+    explicit ScopedStage(char const* name);
+    ScopedStage(ScopedStage const&) = delete;
+    ScopedStage& operator=(ScopedStage const&) = delete;
+    ~ScopedStage();
+
+private:
+    AssetTimings* asset_;
+    bool const traced_;
+    char const* name_;
+    TimingClock::time_point begin_;
+    AllocationScope heap_;
+};
+
+// Records assimp's memory breakdown of the scene into the calling thread's asset.
+void recordSceneMemory(aiMemoryInfo const& info);
+bool recordingAsset();
+
+// Records the importer's progress callbacks into the calling thread's asset.
+class TimingProgressHandler : public Assimp::ProgressHandler
+{
+public:
+    bool Update(float percentage) override;
+};
+
+// Routes assimp's debug log, including AI_CONFIG_GLOB_MEASURE_TIME region timings,
+// into the per-thread asset records. Log messages are emitted on the importing thread, which
+// is also where they are recorded, so parallel imports may log at once.
+void attachTimingLog();
+void detachTimingLog();
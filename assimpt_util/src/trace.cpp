@@ -0,0 +1,161 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+struct TraceEvent
+{
+    char const* category;
+    std::string name;
+    std::string detail;
+    TraceClock::time_point begin;
+    TraceClock::time_point end;
+};
+
+// Only the owning thread appends, writeTrace reads once the threads are done.
+struct TraceBuffer
+{
+    std::size_t id;
+    std::string threadName;
+    std::vector<TraceEvent> events;
+};
+
+std::atomic<bool> enabled{ false };
+TraceClock::time_point origin;
+
+std::mutex buffersMutex;
+std::vector<std::shared_ptr<TraceBuffer>> buffers;
+
+thread_local std::shared_ptr<TraceBuffer> threadBuffer;
+
+TraceBuffer& currentBuffer()
+{
+    if (!threadBuffer) {
+        // kept alive by the registry, a worker may exit long before the trace is written
+        threadBuffer = std::make_shared<TraceBuffer>();
+        threadBuffer->events.reserve(1024);
+        std::lock_guard<std::mutex> lock{ buffersMutex };
+        threadBuffer->id = buffers.size();
+        buffers.push_back(threadBuffer);
+    }
+    return *threadBuffer;
+}
+
+long long microseconds(TraceClock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - origin).count();
+}
+
+void writeJsonString(std::ostream& stream, std::string const& text)
+{
+    stream << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            stream << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            stream << code;
+        }
+        else {
+            stream << c;
+        }
+    }
+    stream << '"';
+}
+
+}
+
+void startTrace()
+{
+    origin = TraceClock::now();
+    enabled = true;
+    traceThreadName("main");
+}
+
+bool traceEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void traceThreadName(std::string name)
+{
+    if (traceEnabled()) {
+        currentBuffer().threadName = std::move(name);
+    }
+}
+
+void traceSpan(char const* category, std::string name, TraceClock::time_point begin, TraceClock::time_point end,
+    std::string detail)
+{
+    if (traceEnabled()) {
+        currentBuffer().events.push_back(TraceEvent{ category, std::move(name), std::move(detail), begin, end });
+    }
+}
+
+bool writeTrace(char const* path)
+{
+    std::ofstream file{ path, std::ios::trunc };
+    if (!file) {
+        std::cerr << "TRACE::ERROR" << std::endl
+            << "Can't open " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock{ buffersMutex };
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (std::shared_ptr<TraceBuffer> const& buffer : buffers) {
+        std::string const threadName = buffer->threadName.empty() ? "worker " + std::to_string(buffer->id) : buffer->threadName;
+        file << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":";
+        writeJsonString(file, threadName);
+        file << "}}";
+        first = false;
+
+        for (TraceEvent const& event : buffer->events) {
+            file << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"cat\":\"" << event.category << "\",\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"ts\":" << microseconds(event.begin) << ",\"dur\":" << microseconds(event.end) - microseconds(event.begin);
+            if (!event.detail.empty()) {
+                file << ",\"args\":{\"detail\":";
+                writeJsonString(file, event.detail);
+                file << "}";
+            }
+            file << "}";
+        }
+    }
+    file << "\n]}\n";
+
+    if (!file) {
+        std::cerr << "TRACE::ERROR" << std::endl
+            << "Can't write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ScopedTrace::ScopedTrace(char const* category, char const* name)
+    : enabled_{ traceEnabled() }
+    , category_{ category }
+    , name_{ name }
+    , begin_{ enabled_ ? TraceClock::now() : TraceClock::time_point{} }
+{
+}
+
+ScopedTrace::~ScopedTrace()
+{
+    if (enabled_) {
+        traceSpan(category_, name_, begin_, TraceClock::now());
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+using TraceClock = std::chrono::steady_clock;
+
+// Chrome trace-event recording, viewable in chrome://tracing or ui.perfetto.dev.
+// Events go to a buffer owned by the recording thread and are only gathered by writeTrace,
+// which must run once every recording thread is done.
+void startTrace();
+bool traceEnabled();
+
+// Names the calling thread on the timeline, unnamed threads show up as "worker <n>".
+void traceThreadName(std::string name);
+
+// A span of the calling thread; detail is shown in the event's arguments when not empty.
+void traceSpan(char const* category, std::string name, TraceClock::time_point begin, TraceClock::time_point end,
+    std::string detail = {});
+
+bool writeTrace(char const* path);
+
+// Records its scope as a span when tracing is on.
+class ScopedTrace
+{
+public:
+    ScopedTrace(char const* category, char const* name);
+    ScopedTrace(ScopedTrace const&) = delete;
+    ScopedTrace& operator=(ScopedTrace const&) = delete;
+    ~ScopedTrace();
+
+private:
+    bool const enabled_;
+    char const* category_;
+    char const* name_;
+    TraceClock::time_point begin_;
+};
@@ -0,0 +1,108 @@
+#include "transforms.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "hash.hpp"
+
+namespace
+{
+
+float const SHEAR_TOLERANCE = 1e-4f;
+float const UNIFORM_SCALE_TOLERANCE = 1e-5f;
+
+// Recomposes the TRS and compares it with the source, relative to the matrix magnitude.
+bool isDecomposable(aiMatrix4x4 const& m, aiVector3D scaling, aiQuaternion rotation, aiVector3D position)
+{
+    aiMatrix4x4 const recomposed{ scaling, rotation, position };
+    float magnitude = 1.0f;
+    float error = 0.0f;
+    for (unsigned int row = 0; row < 3; row++) {
+        for (unsigned int column = 0; column < 4; column++) {
+            magnitude = std::max(magnitude, std::abs(m[row][column]));
+            error = std::max(error, std::abs(m[row][column] - recomposed[row][column]));
+        }
+    }
+    return error <= SHEAR_TOLERANCE * magnitude;
+}
+
+std::int16_t quantizeComponent(float value)
+{
+    // the three smallest components of a unit quaternion lie in [-1/sqrt(2), 1/sqrt(2)]
+    float const normalized = std::min(std::max(value * 1.41421356f, -1.0f), 1.0f);
+    return static_cast<std::int16_t>(std::lround(normalized * 32767.0f));
+}
+
+}
+
+NodeTransforms decomposeTransforms(NodeHierarchy const& hierarchy)
+{
+    std::size_t const nodeCount = hierarchy.nodes.size();
+
+    NodeTransforms transforms;
+    transforms.nameHashes.reserve(nodeCount);
+    transforms.parents = hierarchy.parents;
+    transforms.flags.reserve(nodeCount);
+    transforms.translationX.reserve(nodeCount);
+    transforms.translationY.reserve(nodeCount);
+    transforms.translationZ.reserve(nodeCount);
+    transforms.rotationA.reserve(nodeCount);
+    transforms.rotationB.reserve(nodeCount);
+    transforms.rotationC.reserve(nodeCount);
+    transforms.scales.reserve(nodeCount);
+
+    for (aiNode const* node : hierarchy.nodes) {
+        aiMatrix4x4 const& m = node->mTransformation;
+        aiVector3D scaling;
+        aiQuaternion rotation;
+        aiVector3D position;
+        m.Decompose(scaling, rotation, position);
+        rotation.Normalize();
+
+        std::uint8_t flags = 0;
+        if (!isDecomposable(m, scaling, rotation, position)) {
+            flags |= TRANSFORM_MATRIX_FALLBACK;
+            transforms.fallbackMatrices.push_back(toMatrix3x4(m));
+        }
+
+        float const components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+        std::uint8_t largest = 0;
+        for (std::uint8_t i = 1; i < 4; i++) {
+            if (std::abs(components[i]) > std::abs(components[largest])) {
+                largest = i;
+            }
+        }
+        // q and -q are the same rotation, keeping the dropped component positive lets it be rebuilt
+        float const sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+        std::int16_t quantized[3];
+        for (std::uint8_t i = 0, j = 0; i < 4; i++) {
+            if (i != largest) {
+                quantized[j++] = quantizeComponent(components[i] * sign);
+            }
+        }
+        flags |= largest;
+
+        float const scale = (std::abs(scaling.x) + std::abs(scaling.y) + std::abs(scaling.z)) / 3.0f;
+        bool const uniform =
+            std::abs(scaling.x - scaling.y) <= UNIFORM_SCALE_TOLERANCE * scale &&
+            std::abs(scaling.x - scaling.z) <= UNIFORM_SCALE_TOLERANCE * scale;
+        if (!uniform) {
+            flags |= TRANSFORM_NON_UNIFORM_SCALE;
+            transforms.nonUniformScales.push_back(scaling.x);
+            transforms.nonUniformScales.push_back(scaling.y);
+            transforms.nonUniformScales.push_back(scaling.z);
+        }
+
+        transforms.nameHashes.push_back(hashName(node->mName.C_Str(), node->mName.length));
+        transforms.flags.push_back(flags);
+        transforms.translationX.push_back(position.x);
+        transforms.translationY.push_back(position.y);
+        transforms.translationZ.push_back(position.z);
+        transforms.rotationA.push_back(quantized[0]);
+        transforms.rotationB.push_back(quantized[1]);
+        transforms.rotationC.push_back(quantized[2]);
+        transforms.scales.push_back(uniform ? scaling.x : 1.0f);
+    }
+
+    return transforms;
+}
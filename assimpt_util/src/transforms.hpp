@@ -0,0 +1,6 @@
+#pragma once
+
+#include "animation.hpp"
+#include "data.hpp"
+
+NodeTransforms decomposeTransforms(NodeHierarchy const& hierarchy);
@@ -0,0 +1,94 @@
+#include "vat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "skinning.hpp"
+
+namespace
+{
+
+std::uint16_t quantizeUnorm16(float value, float min, float extent)
+{
+    if (extent <= 0.0f) {
+        return 0;
+    }
+    float const normalized = std::min(std::max((value - min) / extent, 0.0f), 1.0f);
+    return static_cast<std::uint16_t>(std::lround(normalized * 65535.0f));
+}
+
+std::int8_t quantizeSnorm8(float value)
+{
+    float const clamped = std::min(std::max(value, -1.0f), 1.0f);
+    return static_cast<std::int8_t>(std::lround(clamped * 127.0f));
+}
+
+}
+
+VertexAnimation bakeVertexAnimation(aiScene const* scene, NodeHierarchy const& hierarchy, aiMesh const* mesh,
+    unsigned int animationIndex, float frameRate)
+{
+    aiAnimation const* animation = scene->mAnimations[animationIndex];
+    double const ticksPerSecond = animationTicksPerSecond(animation);
+    double const duration = std::max(animation->mDuration, 0.0);
+
+    VertexAnimation result;
+    result.animation = animationIndex;
+    result.frameCount = static_cast<std::uint32_t>(std::floor(duration / ticksPerSecond * frameRate)) + 1;
+    result.vertexCount = mesh->mNumVertices;
+    result.frameRate = frameRate;
+
+    aiMatrix4x4 globalInverse = scene->mRootNode->mTransformation;
+    globalInverse.Inverse();
+
+    AnimationBinding const animationBinding = bindAnimation(hierarchy, animation);
+    SkinBinding const binding = bindSkin(mesh, hierarchy);
+
+    std::vector<aiMatrix4x4> globalTransforms;
+    std::vector<SkinMatrix> skinMatrices;
+    std::vector<float> positions;
+    std::vector<float> normals;
+
+    std::size_t const texelCount = static_cast<std::size_t>(result.frameCount) * result.vertexCount;
+    std::vector<float> bakedPositions(texelCount * 3);
+    result.normals.assign(texelCount * 4, 0);
+
+    float boundsMin[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float boundsMax[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+    for (std::uint32_t frame = 0; frame < result.frameCount; frame++) {
+        double const time = std::min(frame / static_cast<double>(frameRate) * ticksPerSecond, duration);
+        evaluatePose(hierarchy, animation, animationBinding, time, globalTransforms);
+        computeSkinMatrices(binding, globalTransforms, globalInverse, skinMatrices);
+        skinVertices(mesh, binding, skinMatrices, positions, normals);
+
+        std::size_t const row = static_cast<std::size_t>(frame) * result.vertexCount;
+        std::copy(positions.begin(), positions.end(), bakedPositions.begin() + row * 3);
+        for (std::size_t i = 0; i < positions.size(); i++) {
+            boundsMin[i % 3] = std::min(boundsMin[i % 3], positions[i]);
+            boundsMax[i % 3] = std::max(boundsMax[i % 3], positions[i]);
+        }
+        for (std::size_t i = 0; i < normals.size() / 3; i++) {
+            for (std::size_t c = 0; c < 3; c++) {
+                result.normals[(row + i) * 4 + c] = quantizeSnorm8(normals[i * 3 + c]);
+            }
+        }
+    }
+
+    if (texelCount == 0) {
+        std::fill(boundsMin, boundsMin + 3, 0.0f);
+        std::fill(boundsMax, boundsMax + 3, 0.0f);
+    }
+    std::copy(boundsMin, boundsMin + 3, result.boundsMin);
+    std::copy(boundsMax, boundsMax + 3, result.boundsMax);
+
+    result.positions.assign(texelCount * 4, 0);
+    for (std::size_t i = 0; i < texelCount; i++) {
+        for (std::size_t c = 0; c < 3; c++) {
+            result.positions[i * 4 + c] = quantizeUnorm16(bakedPositions[i * 3 + c], boundsMin[c], boundsMax[c] - boundsMin[c]);
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <assimp\scene.h>
+
+#include "animation.hpp"
+#include "data.hpp"
+
+// Plays the animation through the reference CPU skinning engine and samples
+// skinned positions and normals at a fixed frame rate.
+VertexAnimation bakeVertexAnimation(aiScene const* scene, NodeHierarchy const& hierarchy, aiMesh const* mesh,
+    unsigned int animationIndex, float frameRate);
@@ -0,0 +1,287 @@
+#include "watch.hpp"
+
+#include <iostream>
+
+#ifndef __linux__
+
+bool runWatch(std::size_t, InputsFunction const&, RebuildFunction const&, std::size_t)
+{
+    std::cerr << "WATCH::ERROR" << std::endl
+        << "Watch mode needs inotify and is only supported on Linux" << std::endl;
+    return false;
+}
+
+#else
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "parallel.hpp"
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using WatchedFile = std::pair<int, std::string>;
+
+std::chrono::milliseconds const QUIET_PERIOD{ 100 };
+std::chrono::milliseconds const MAX_DELAY{ 500 };
+int const POLL_TIMEOUT_MS = 50;
+
+std::atomic<bool> interrupted{ false };
+
+void onInterrupt(int)
+{
+    interrupted = true;
+}
+
+void splitPath(std::string const& path, std::string& directory, std::string& name)
+{
+    std::size_t const separator = path.find_last_of('/');
+    if (separator == std::string::npos) {
+        directory = ".";
+        name = path;
+    }
+    else {
+        directory = separator == 0 ? "/" : path.substr(0, separator);
+        name = path.substr(separator + 1);
+    }
+}
+
+// Which jobs read which file, as (watch descriptor, file name) pairs.
+class WatchGraph
+{
+public:
+    explicit WatchGraph(int inotify) : inotify_{ inotify } { }
+
+    void Update(std::size_t job, std::vector<std::string> const& inputs)
+    {
+        for (WatchedFile const& file : filesByJob_[job]) {
+            jobsByFile_[file].erase(job);
+        }
+        filesByJob_[job].clear();
+
+        for (std::string const& input : inputs) {
+            std::string directory;
+            std::string name;
+            splitPath(input, directory, name);
+            int const watch = Watch(directory);
+            if (watch < 0) {
+                continue;
+            }
+            WatchedFile const file{ watch, name };
+            jobsByFile_[file].insert(job);
+            filesByJob_[job].push_back(file);
+        }
+    }
+
+    std::set<std::size_t> const* JobsReading(WatchedFile const& file) const
+    {
+        auto const found = jobsByFile_.find(file);
+        return found == jobsByFile_.end() ? nullptr : &found->second;
+    }
+
+private:
+    int Watch(std::string const& directory)
+    {
+        auto const found = watchByDirectory_.find(directory);
+        if (found != watchByDirectory_.end()) {
+            return found->second;
+        }
+        // editors save through a temporary file and a rename as often as in place
+        int const watch = inotify_add_watch(inotify_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (watch < 0) {
+            std::cerr << "WATCH::ERROR" << std::endl
+                << "Can't watch " << directory << std::endl;
+        }
+        watchByDirectory_[directory] = watch;
+        return watch;
+    }
+
+    int const inotify_;
+    std::map<std::string, int> watchByDirectory_;
+    std::map<WatchedFile, std::set<std::size_t>> jobsByFile_;
+    std::map<std::size_t, std::vector<WatchedFile>> filesByJob_;
+};
+
+struct RebuildQueue
+{
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::size_t> pending;
+    // queued or running, a running job changed again lands in again
+    std::set<std::size_t> scheduled;
+    std::set<std::size_t> again;
+    // rebuilt jobs whose inputs the watching thread has to refresh
+    std::vector<std::size_t> finished;
+    bool stopping = false;
+
+    void Schedule(std::size_t job)
+    {
+        std::lock_guard<std::mutex> lock{ mutex };
+        if (!scheduled.insert(job).second) {
+            again.insert(job);
+            return;
+        }
+        pending.push_back(job);
+        available.notify_one();
+    }
+};
+
+void rebuildJobs(RebuildQueue& queue, RebuildFunction const& rebuild)
+{
+    ParallelWorkerScope worker;
+    for (;;) {
+        std::size_t job;
+        {
+            std::unique_lock<std::mutex> lock{ queue.mutex };
+            queue.available.wait(lock, [&] { return queue.stopping || !queue.pending.empty(); });
+            if (queue.stopping) {
+                return;
+            }
+            job = queue.pending.front();
+            queue.pending.pop_front();
+            // a change from here on needs another rebuild
+            queue.again.erase(job);
+        }
+
+        rebuild(job);
+
+        std::lock_guard<std::mutex> lock{ queue.mutex };
+        queue.finished.push_back(job);
+        if (queue.again.erase(job) > 0) {
+            queue.pending.push_back(job);
+            queue.available.notify_one();
+        }
+        else {
+            queue.scheduled.erase(job);
+        }
+    }
+}
+
+}
+
+bool runWatch(std::size_t jobCount, InputsFunction const& inputsOf, RebuildFunction const& rebuild, std::size_t workerCount)
+{
+    int const inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify < 0) {
+        std::cerr << "WATCH::ERROR" << std::endl
+            << "Can't initialize inotify" << std::endl;
+        return false;
+    }
+
+    WatchGraph graph{ inotify };
+    for (std::size_t job = 0; job < jobCount; job++) {
+        graph.Update(job, inputsOf(job));
+    }
+
+    interrupted = false;
+    std::signal(SIGINT, onInterrupt);
+    std::signal(SIGTERM, onInterrupt);
+
+    RebuildQueue queue;
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < std::max<std::size_t>(workerCount, 1); i++) {
+        workers.emplace_back(rebuildJobs, std::ref(queue), std::cref(rebuild));
+    }
+
+    std::cout << "Watching " << jobCount << " assets, Ctrl+C to stop" << std::endl;
+
+    std::set<WatchedFile> changed;
+    bool overflowed = false;
+    Clock::time_point firstChange;
+    Clock::time_point lastChange;
+    alignas(inotify_event) char events[16 * 1024];
+    while (!interrupted) {
+        pollfd descriptor{ inotify, POLLIN, 0 };
+        int const ready = poll(&descriptor, 1, POLL_TIMEOUT_MS);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (ready > 0) {
+            bool const idle = changed.empty() && !overflowed;
+            for (;;) {
+                ssize_t const length = read(inotify, events, sizeof(events));
+                if (length <= 0) {
+                    break;
+                }
+                for (char const* position = events; position < events + length; ) {
+                    inotify_event const* event = reinterpret_cast<inotify_event const*>(position);
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        overflowed = true;
+                    }
+                    else if (event->len > 0) {
+                        changed.emplace(event->wd, event->name);
+                    }
+                    position += sizeof(inotify_event) + event->len;
+                }
+            }
+            lastChange = Clock::now();
+            if (idle) {
+                firstChange = lastChange;
+            }
+        }
+
+        // inputs can change with a rebuild, a new texture reference needs a new watch
+        std::vector<std::size_t> finished;
+        {
+            std::lock_guard<std::mutex> lock{ queue.mutex };
+            finished.swap(queue.finished);
+        }
+        for (std::size_t job : finished) {
+            graph.Update(job, inputsOf(job));
+        }
+
+        Clock::time_point const now = Clock::now();
+        bool const settled = now - lastChange >= QUIET_PERIOD || now - firstChange >= MAX_DELAY;
+        if ((changed.empty() && !overflowed) || !settled) {
+            continue;
+        }
+
+        if (overflowed) {
+            // events were lost, every job checks its own inputs
+            for (std::size_t job = 0; job < jobCount; job++) {
+                queue.Schedule(job);
+            }
+        }
+        else {
+            for (WatchedFile const& file : changed) {
+                if (std::set<std::size_t> const* jobs = graph.JobsReading(file)) {
+                    for (std::size_t job : *jobs) {
+                        queue.Schedule(job);
+                    }
+                }
+            }
+        }
+        changed.clear();
+        overflowed = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{ queue.mutex };
+        queue.stopping = true;
+    }
+    queue.available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    close(inotify);
+    return true;
+}
+
+#endif
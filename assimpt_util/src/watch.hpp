@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Files a job's output was built from, asked again after every rebuild.
+using InputsFunction = std::function<std::vector<std::string>(std::size_t job)>;
+using RebuildFunction = std::function<void(std::size_t job)>;
+
+// Watches the directories holding every job's inputs until SIGINT or SIGTERM.
+// Events are debounced (100 ms of quiet, at most 500 ms after the first one) and
+// each affected job is rebuilt once on one of workerCount threads; a job changed
+// again while it rebuilds is queued once more after it finishes.
+bool runWatch(std::size_t jobCount, InputsFunction const& inputsOf, RebuildFunction const& rebuild, std::size_t workerCount);
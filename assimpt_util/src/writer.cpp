@@ -0,0 +1,536 @@
+#include "writer.hpp"
+
+#include "container.hpp"
+#include "io.hpp"
+
+#include <iostream>
+
+namespace
+{
+
+class StreamWriter : public OutputWriter
+{
+public:
+    bool Write(char const* destName, std::vector<std::uint8_t> const& bytes) override
+    {
+        return writeOutput(destName, bytes);
+    }
+};
+
+}
+
+bool parseWriterKind(std::string const& name, WriterKind& kind)
+{
+    if (name == "stream") {
+        kind = WriterKind::Stream;
+    }
+    else if (name == "pwrite") {
+        kind = WriterKind::Pwrite;
+    }
+    else if (name == "uring") {
+        kind = WriterKind::Uring;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+#ifdef _WIN32
+
+std::unique_ptr<OutputWriter> createOutputWriter(WriterKind kind, bool direct)
+{
+    return std::unique_ptr<OutputWriter>{ new StreamWriter };
+}
+
+#else
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace
+{
+
+// O_DIRECT wants buffers, offsets and lengths aligned to the logical block size,
+// a page covers every common device
+std::size_t const DIRECT_ALIGNMENT = 4096;
+std::size_t const CHUNK_SIZE = 1 << 20;
+
+std::size_t alignUp(std::size_t value, std::size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+struct AlignedFree
+{
+    void operator()(std::uint8_t* buffer) const { std::free(buffer); }
+};
+using AlignedBuffer = std::unique_ptr<std::uint8_t, AlignedFree>;
+
+AlignedBuffer allocateAligned(std::size_t size)
+{
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, DIRECT_ALIGNMENT, size) != 0) {
+        return nullptr;
+    }
+    return AlignedBuffer{ static_cast<std::uint8_t*>(buffer) };
+}
+
+// Sets direct to whether the descriptor really bypasses the page cache.
+int openOutput(char const* destName, bool& direct)
+{
+#ifdef O_DIRECT
+    if (direct) {
+        int const file = open(destName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+        // tmpfs and some network file systems refuse O_DIRECT
+        if (file >= 0 || errno != EINVAL) {
+            return file;
+        }
+    }
+#endif
+    direct = false;
+    return open(destName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+// Direct writes were padded to whole blocks, the file is cut back to the real size.
+bool finishOutput(int file, bool direct, std::size_t size)
+{
+    bool finished = !direct || ftruncate(file, static_cast<off_t>(size)) == 0;
+    finished = close(file) == 0 && finished;
+    return finished;
+}
+
+void reportWriteError(char const* destName)
+{
+    std::cerr << "WRITER::ERROR" << std::endl
+        << "Can't write the file " << destName << ": " << std::strerror(errno) << std::endl;
+}
+
+class PwriteWriter : public OutputWriter
+{
+public:
+    explicit PwriteWriter(bool direct) : direct_{ direct } { }
+
+    bool Write(char const* destName, std::vector<std::uint8_t> const& bytes) override
+    {
+        if (isStandardStream(destName)) {
+            return writeOutput(destName, bytes);
+        }
+        bool direct = direct_;
+        int const file = openOutput(destName, direct);
+        if (file < 0) {
+            reportWriteError(destName);
+            return false;
+        }
+
+        // direct writes go through a block aligned copy, one chunk at a time
+        AlignedBuffer staging;
+        if (direct) {
+            staging = allocateAligned(CHUNK_SIZE);
+            if (!staging) {
+                close(file);
+                return false;
+            }
+        }
+
+        std::size_t offset = 0;
+        while (offset < bytes.size()) {
+            std::size_t const chunk = std::min(CHUNK_SIZE, bytes.size() - offset);
+            std::uint8_t const* data = bytes.data() + offset;
+            std::size_t length = chunk;
+            if (direct) {
+                length = alignUp(chunk, DIRECT_ALIGNMENT);
+                std::memcpy(staging.get(), data, chunk);
+                std::memset(staging.get() + chunk, 0, length - chunk);
+                data = staging.get();
+            }
+            ssize_t const written = pwrite(file, data, length, static_cast<off_t>(offset));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0 || (direct && static_cast<std::size_t>(written) != length)) {
+                reportWriteError(destName);
+                close(file);
+                return false;
+            }
+            offset += std::min(static_cast<std::size_t>(written), chunk);
+        }
+
+        if (!finishOutput(file, direct, bytes.size())) {
+            reportWriteError(destName);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool const direct_;
+};
+
+#ifdef __linux__
+
+int ioUringSetup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int ring, unsigned submit, unsigned wait, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring, submit, wait, flags, nullptr, 0));
+}
+
+int ioUringRegister(int ring, unsigned opcode, void const* arguments, unsigned count)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, ring, opcode, arguments, count));
+}
+
+// One ring with a fixed set of registered staging buffers shared by every worker. Each output
+// is copied chunk by chunk into free buffers and written with IORING_OP_WRITE_FIXED, so up to
+// BUFFER_COUNT writes are in flight while the next chunk is copied. mutex_ only guards the
+// rings and the buffer bookkeeping: copies happen outside it, and one thread at a time waits
+// for completions in the kernel while the others wait for it to hand theirs over.
+class UringWriter : public OutputWriter
+{
+public:
+    static unsigned const BUFFER_COUNT = 8;
+
+    static std::unique_ptr<UringWriter> Create(bool direct)
+    {
+        std::unique_ptr<UringWriter> writer{ new UringWriter{ direct } };
+        if (!writer->Setup()) {
+            return nullptr;
+        }
+        return writer;
+    }
+
+    ~UringWriter() override
+    {
+        if (sqes_ != MAP_FAILED) {
+            munmap(sqes_, sqesSize_);
+        }
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) {
+            munmap(cqRing_, cqRingSize_);
+        }
+        if (sqRing_ != MAP_FAILED) {
+            munmap(sqRing_, sqRingSize_);
+        }
+        if (ring_ >= 0) {
+            close(ring_);
+        }
+    }
+
+    bool Write(char const* destName, std::vector<std::uint8_t> const& bytes) override
+    {
+        if (isStandardStream(destName)) {
+            return writeOutput(destName, bytes);
+        }
+        bool broken;
+        {
+            std::lock_guard<std::mutex> lock{ mutex_ };
+            broken = broken_;
+        }
+        if (broken) {
+            return fallback_.Write(destName, bytes);
+        }
+
+        bool direct = direct_;
+        int const file = openOutput(destName, direct);
+        if (file < 0) {
+            reportWriteError(destName);
+            return false;
+        }
+
+        WriteState state;
+        std::size_t offset = 0;
+        std::unique_lock<std::mutex> lock{ mutex_ };
+        for (;;) {
+            if (!reaping_) {
+                Reap();
+            }
+            bool const more = offset < bytes.size() && !state.failed && !broken_;
+            if (lost_ || (!more && state.inFlight == 0)) {
+                break;
+            }
+
+            if (more && !freeBuffers_.empty()) {
+                unsigned const buffer = freeBuffers_.back();
+                freeBuffers_.pop_back();
+                lock.unlock();
+                std::size_t const chunk = std::min(CHUNK_SIZE, bytes.size() - offset);
+                std::size_t const length = direct ? alignUp(chunk, DIRECT_ALIGNMENT) : chunk;
+                std::memcpy(buffers_[buffer].get(), bytes.data() + offset, chunk);
+                std::memset(buffers_[buffer].get() + chunk, 0, length - chunk);
+                lock.lock();
+
+                if (!broken_ && Submit(file, buffer, length, offset)) {
+                    slots_[buffer] = Slot{ &state, static_cast<unsigned>(length) };
+                    state.inFlight++;
+                    inFlight_++;
+                    offset += chunk;
+                }
+                else {
+                    if (!broken_) {
+                        // the ring isn't reused, writes already queued are drained first
+                        broken_ = true;
+                        reportWriteError(destName);
+                    }
+                    freeBuffers_.push_back(buffer);
+                }
+                available_.notify_all();
+            }
+            else if (!reaping_ && inFlight_ > 0) {
+                // no one else reaps while this thread waits, so what it waits for can't be
+                // taken from the queue behind its back
+                reaping_ = true;
+                lock.unlock();
+                int const waited = ioUringEnter(ring_, 0, 1, IORING_ENTER_GETEVENTS);
+                int const error = errno;
+                lock.lock();
+                reaping_ = false;
+                if (waited < 0 && error != EINTR) {
+                    broken_ = true;
+                    lost_ = true;
+                }
+                available_.notify_all();
+            }
+            else {
+                available_.wait(lock);
+            }
+        }
+
+        if (state.inFlight > 0) {
+            // the ring can't report these writes any more and they may still land in the file,
+            // rewriting it through the fallback could be overwritten by them
+            for (Slot& slot : slots_) {
+                if (slot.owner == &state) {
+                    slot.owner = nullptr;
+                }
+            }
+            lock.unlock();
+            std::cerr << "WRITER::ERROR" << std::endl
+                << "Lost track of the writes to " << destName << std::endl;
+            close(file);
+            return false;
+        }
+        lock.unlock();
+
+        if (state.failed) {
+            errno = state.error;
+            reportWriteError(destName);
+            close(file);
+            return false;
+        }
+        if (offset < bytes.size()) {
+            // every write queued for this file has completed, nothing can land after the fallback
+            close(file);
+            return fallback_.Write(destName, bytes);
+        }
+        if (!finishOutput(file, direct, bytes.size())) {
+            reportWriteError(destName);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct WriteState
+    {
+        unsigned inFlight = 0;
+        bool failed = false;
+        int error = 0;
+    };
+
+    // The write a registered buffer is in flight for.
+    struct Slot
+    {
+        WriteState* owner;
+        unsigned expected;
+    };
+
+    explicit UringWriter(bool direct) : direct_{ direct }, fallback_{ direct } { }
+
+    bool Setup()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_ = ioUringSetup(BUFFER_COUNT, &params);
+        if (ring_ < 0) {
+            return false;
+        }
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool const singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) {
+            return false;
+        }
+        cqRing_ = singleMap ? sqRing_ : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            return false;
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) {
+            return false;
+        }
+
+        char* sq = static_cast<char*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        // registered once, the kernel skips pinning the pages on every write
+        iovec registered[BUFFER_COUNT];
+        for (unsigned i = 0; i < BUFFER_COUNT; i++) {
+            buffers_[i] = allocateAligned(CHUNK_SIZE);
+            if (!buffers_[i]) {
+                return false;
+            }
+            registered[i].iov_base = buffers_[i].get();
+            registered[i].iov_len = CHUNK_SIZE;
+            slots_[i] = Slot{ nullptr, 0 };
+            freeBuffers_.push_back(i);
+        }
+        return ioUringRegister(ring_, IORING_REGISTER_BUFFERS, registered, BUFFER_COUNT) == 0;
+    }
+
+    // Called with mutex_ held. Queues the write and hands it to the kernel at once, only ever
+    // one entry is queued; one the kernel didn't take is taken back, no later
+    // io_uring_enter can submit it after the fallback rewrote the file.
+    bool Submit(int file, unsigned buffer, std::size_t length, std::size_t offset)
+    {
+        // at most BUFFER_COUNT writes are in flight, the ring never fills up
+        unsigned const tail = *sqTail_;
+        unsigned const index = tail & *sqMask_;
+        io_uring_sqe& entry = static_cast<io_uring_sqe*>(sqes_)[index];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_WRITE_FIXED;
+        entry.fd = file;
+        entry.addr = reinterpret_cast<std::uint64_t>(buffers_[buffer].get());
+        entry.len = static_cast<unsigned>(length);
+        entry.off = offset;
+        entry.buf_index = static_cast<std::uint16_t>(buffer);
+        entry.user_data = buffer;
+        sqArray_[index] = index;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+
+        int submitted;
+        do {
+            submitted = ioUringEnter(ring_, 1, 0, 0);
+        } while (submitted < 0 && errno == EINTR);
+        if (__atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) == tail + 1) {
+            return true;
+        }
+        int const error = errno;
+        __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+        errno = submitted < 0 ? error : EAGAIN;
+        return false;
+    }
+
+    // Called with mutex_ held and no thread waiting in the kernel. Hands every completion to
+    // its write and frees its buffer.
+    void Reap()
+    {
+        unsigned head = *cqHead_;
+        unsigned const tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            return;
+        }
+        for (; head != tail; head++) {
+            io_uring_cqe const& completion = cqes_[head & *cqMask_];
+            unsigned const buffer = static_cast<unsigned>(completion.user_data);
+            Slot& slot = slots_[buffer];
+            // a regular file only writes short on errors like a full disk
+            if (slot.owner && (completion.res < 0 || static_cast<unsigned>(completion.res) != slot.expected)) {
+                slot.owner->failed = true;
+                slot.owner->error = completion.res < 0 ? -completion.res : EIO;
+            }
+            if (slot.owner) {
+                slot.owner->inFlight--;
+            }
+            slot.owner = nullptr;
+            freeBuffers_.push_back(buffer);
+            inFlight_--;
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        available_.notify_all();
+    }
+
+    bool const direct_;
+    PwriteWriter fallback_;
+
+    std::mutex mutex_;
+    std::condition_variable available_;
+    // a submission failed, new outputs go to the fallback
+    bool broken_ = false;
+    // waiting for completions failed, writes still in flight can't be drained
+    bool lost_ = false;
+    bool reaping_ = false;
+    unsigned inFlight_ = 0;
+    std::vector<unsigned> freeBuffers_;
+    Slot slots_[BUFFER_COUNT];
+
+    int ring_ = -1;
+    void* sqRing_ = MAP_FAILED;
+    void* cqRing_ = MAP_FAILED;
+    void* sqes_ = MAP_FAILED;
+    std::size_t sqRingSize_ = 0;
+    std::size_t cqRingSize_ = 0;
+    std::size_t sqesSize_ = 0;
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqMask_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned* cqMask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    AlignedBuffer buffers_[BUFFER_COUNT];
+};
+
+#endif
+
+}
+
+std::unique_ptr<OutputWriter> createOutputWriter(WriterKind kind, bool direct)
+{
+    if (kind == WriterKind::Stream) {
+        return std::unique_ptr<OutputWriter>{ new StreamWriter };
+    }
+#ifdef __linux__
+    if (kind == WriterKind::Uring) {
+        if (std::unique_ptr<UringWriter> writer = UringWriter::Create(direct)) {
+            return writer;
+        }
+        std::cerr << "io_uring is unavailable, writing with pwrite" << std::endl;
+    }
+#endif
+    return std::unique_ptr<OutputWriter>{ new PwriteWriter{ direct } };
+}
+
+#endif
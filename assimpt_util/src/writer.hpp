@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Where finished containers go, shared by every worker of a run.
+class OutputWriter
+{
+public:
+    virtual ~OutputWriter() = default;
+
+    // destName "-" always goes to stdout through writeOutput.
+    virtual bool Write(char const* destName, std::vector<std::uint8_t> const& bytes) = 0;
+};
+
+enum class WriterKind
+{
+    // std::ofstream, buffered through the page cache
+    Stream,
+    // large pwrite calls on a raw descriptor
+    Pwrite,
+    // io_uring writes from registered buffers
+    Uring,
+};
+
+bool parseWriterKind(std::string const& name, WriterKind& kind);
+
+// direct opens outputs with O_DIRECT, skipping the page cache; file systems that refuse it
+// get buffered writes. io_uring falls back to pwrite where the kernel or a sandbox doesn't
+// offer it, and both fall back to streams on Windows.
+std::unique_ptr<OutputWriter> createOutputWriter(WriterKind kind, bool direct);